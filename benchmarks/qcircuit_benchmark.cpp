@@ -0,0 +1,209 @@
+//Copyright (c) 2020 Jij Inc.
+
+#include <benchmark/benchmark.h>
+#include <itensor/all.h>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <qcircuit.hpp>
+#include <circuit_topology.hpp>
+#include <quantum_gate.hpp>
+#include <circuits.hpp>
+
+using namespace qcircuit;
+
+namespace {
+
+    /**
+     * @brief applies `depth` layers of random two-qubit unitaries in a brick-wall pattern
+     * on the pairs `(i, i+1)`. Pairs without a link between them are skipped.
+     */
+    void applyRandomLayers(QCircuit& circuit, size_t depth, unsigned seed) {
+        std::mt19937 engine(seed);
+        std::uniform_real_distribution<> angle(0.0, 2*M_PI);
+        const size_t n = circuit.size();
+
+        for(size_t layer = 0;layer < depth;layer++) {
+            for(size_t i = layer % 2;i+1 < n;i += 2) {
+                if(!circuit.getTopology().hasLinkBetween(i, i+1)) {
+                    continue;
+                }
+                circuit.apply(UniversalUnitary(i, angle(engine), angle(engine), angle(engine)));
+                circuit.apply(CUniversalUnitary(i, i+1, angle(engine), angle(engine), angle(engine)));
+            }
+        }
+    }
+
+    QCircuit makeCircuit(const CircuitTopology& topology) {
+        QCircuit circuit(topology);
+        circuit.setCutoff(1e-8);
+        circuit.setSeed(1);
+        return circuit;
+    }
+
+    CircuitTopology makeTopology(int kind, size_t size) {
+        switch(kind) {
+        case 0: return make_chain(size, false);
+        case 1: return make_alltoall_topology(size);
+        default: return make_ibmq_topology();
+        }
+    }
+
+    const char* topologyName(int kind) {
+        switch(kind) {
+        case 0: return "chain";
+        case 1: return "alltoall";
+        default: return "ibmq";
+        }
+    }
+
+} // namespace
+
+
+/* apply() throughput per gate type, at the cursor position */
+
+template<typename Gate, typename... Params>
+static void BM_ApplyGate(benchmark::State& state, Params... params) {
+    auto circuit = makeCircuit(make_chain(8, false));
+    applyRandomLayers(circuit, 2, 0);
+    circuit.moveCursorTo(0, 1); // the layers leave the cursor at the other end of the chain
+    const Gate gate(params...);
+
+    for(auto _ : state) {
+        circuit.apply(gate);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_ApplyH(benchmark::State& state) { BM_ApplyGate<H>(state, size_t(0)); }
+static void BM_ApplyP(benchmark::State& state) { BM_ApplyGate<P>(state, size_t(0), 0.3); }
+static void BM_ApplyProj_0(benchmark::State& state) { BM_ApplyGate<Proj_0>(state, size_t(0)); }
+static void BM_ApplyCNOT(benchmark::State& state) { BM_ApplyGate<CNOT>(state, size_t(0), size_t(1)); }
+static void BM_ApplyCZ(benchmark::State& state) { BM_ApplyGate<CZ>(state, size_t(0), size_t(1)); }
+static void BM_ApplySwap(benchmark::State& state) { BM_ApplyGate<Swap>(state, size_t(0), size_t(1)); }
+static void BM_ApplyCUniversalUnitary(benchmark::State& state) {
+    BM_ApplyGate<CUniversalUnitary>(state, size_t(0), size_t(1), 0.1, 0.2, 0.3);
+}
+BENCHMARK(BM_ApplyH);
+BENCHMARK(BM_ApplyP);
+BENCHMARK(BM_ApplyProj_0);
+BENCHMARK(BM_ApplyCNOT);
+BENCHMARK(BM_ApplyCZ);
+BENCHMARK(BM_ApplySwap);
+BENCHMARK(BM_ApplyCUniversalUnitary);
+
+
+/* shiftCursorTo() cost vs bond dimension.
+ * A diagonal gate is applied before every shift, so that each shift decomposes `Psi`.
+ * The central bonds of the 16-site chain can reach 256, so MaxDim bounds the bond dimension;
+ * the measured one is reported.
+ */
+static void BM_ShiftCursor(benchmark::State& state) {
+    const int max_dim = static_cast<int>(state.range(0));
+    auto circuit = makeCircuit(make_chain(16, false));
+    circuit.setMaxDim(max_dim);
+    applyRandomLayers(circuit, 32, 0);
+    circuit.moveCursorTo(7, 8);
+
+    // The cursor walks (7, 8) -> (8, 9) -> (7, 8) in every iteration.
+    for(auto _ : state) {
+        circuit.apply(CZ(7, 8));
+        circuit.moveCursorAlong({9});
+        circuit.apply(CZ(8, 9));
+        circuit.moveCursorAlong({7});
+    }
+    state.SetItemsProcessed(2*state.iterations());
+    state.counters["max_dim"] = max_dim;
+    state.counters["bond_dim"] = circuit.bondDimensions()[circuit.getTopology().getLinkIdBetween(7, 8)];
+}
+BENCHMARK(BM_ShiftCursor)->RangeMultiplier(2)->Range(2, 64);
+
+
+/* probabilityOf() and overlap() scaling vs N. Arguments are (topology kind, N). */
+
+static void BM_ProbabilityOf(benchmark::State& state) {
+    const int kind = static_cast<int>(state.range(0));
+    auto topology = makeTopology(kind, state.range(1));
+    auto circuit = makeCircuit(topology);
+    applyRandomLayers(circuit, 4, 0);
+
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(circuit.probabilityOf(circuit.size()-1, 0));
+    }
+    state.SetLabel(topologyName(kind));
+    state.counters["N"] = circuit.size();
+}
+
+static void BM_Overlap(benchmark::State& state) {
+    const int kind = static_cast<int>(state.range(0));
+    auto topology = makeTopology(kind, state.range(1));
+    auto circuit1 = makeCircuit(topology);
+    applyRandomLayers(circuit1, 4, 0);
+    auto circuit2 = circuit1.fork();
+    applyRandomLayers(circuit2, 1, 1);
+
+    std::vector<ITensor> identity;
+    for(size_t i = 0;i < circuit1.size();i++) {
+        identity.push_back(circuit1.generateTensorOp(Id(i)));
+    }
+
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(overlap(circuit1, identity, circuit2));
+    }
+    state.SetLabel(topologyName(kind));
+    state.counters["N"] = circuit1.size();
+}
+
+static void TopologyArguments(benchmark::internal::Benchmark* b) {
+    for(int kind : {0, 1}) {
+        for(int n : {4, 8, 16, 32}) {
+            b->Args({kind, n});
+        }
+    }
+    b->Args({2, 53});
+}
+BENCHMARK(BM_ProbabilityOf)->Apply(TopologyArguments);
+BENCHMARK(BM_Overlap)->Apply(TopologyArguments);
+
+
+/* End-to-end runs */
+
+static void BM_RandomCircuit(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const size_t depth = state.range(1);
+    auto topology = make_chain(n, false);
+
+    for(auto _ : state) {
+        auto circuit = makeCircuit(topology);
+        circuit.setMaxDim(64);
+        applyRandomLayers(circuit, depth, 0);
+        benchmark::DoNotOptimize(circuit.marginalProbabilities());
+    }
+    state.counters["N"] = n;
+    state.counters["depth"] = depth;
+}
+BENCHMARK(BM_RandomCircuit)->Args({8, 8})->Args({16, 8})->Args({16, 16})->Args({32, 16})->Unit(benchmark::kMillisecond);
+
+/* QFT on the all-to-all topology, so that every controlled phase acts on a link. */
+static void BM_QFT(benchmark::State& state) {
+    const size_t n = state.range(0);
+    auto topology = make_alltoall_topology(n);
+
+    for(auto _ : state) {
+        auto circuit = makeCircuit(topology);
+        for(size_t i = 0;i < n;i += 2) {
+            circuit.apply(X(i));
+        }
+        for(size_t i = 0;i < n;i++) {
+            circuit.apply(H(i));
+            for(size_t j = i+1;j < n;j++) {
+                circuit.apply(CP(j, i, M_PI/std::pow(2.0, j-i)));
+            }
+        }
+        benchmark::DoNotOptimize(circuit.marginalProbabilities());
+    }
+    state.counters["N"] = n;
+}
+BENCHMARK(BM_QFT)->Arg(4)->Arg(8)->Arg(12)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
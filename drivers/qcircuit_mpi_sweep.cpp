@@ -0,0 +1,231 @@
+//Copyright (c) 2020 Jij Inc.
+
+/*
+ * MPI driver of parameter sweeps of an OpenQASM program.
+ *
+ *   mpirun -n 16 qcircuit_mpi_sweep --qasm ansatz.qasm --grid grid.csv [options]
+ *
+ * grid.csv has a header line with the names of the free parameters of the program,
+ * followed by one line of values per point.
+ *
+ * Options:
+ *   --topology chain:N | alltoall:N | ibmq   Topology of a fresh circuit (default chain:50).
+ *   --prefix FILE        Checkpoint (QCircuit::save()) from which every point starts, read on rank 0.
+ *                        Its topology overrides --topology.
+ *   --shots N            Number of samples per point (default 0).
+ *   --seed S             Seed of the point i is S + i (default 0).
+ *   --cutoff X           Cutoff of the singular values of a fresh circuit (default 1e-8).
+ *   --max-dim D          Maximum bond dimension of a fresh circuit.
+ *   --output FILE        Results in CSV (default: standard output).
+ *   --samples FILE       Samples in CSV, one line per shot.
+ *
+ * The results have one line per point with the parameter values, <Z> of each declared qubit,
+ * and the value of each classical register.
+ */
+
+#include <mpi.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <qcircuit.hpp>
+#include <circuits.hpp>
+#include <qasm_program.hpp>
+#include <parameter_sweep.hpp>
+#include <mpi_sweep.hpp>
+
+using namespace qcircuit;
+
+namespace {
+
+    std::vector<std::string> splitCsvLine(const std::string& line) {
+        std::vector<std::string> ret;
+        std::stringstream ss(line);
+        std::string cell;
+        while(std::getline(ss, cell, ',')) {
+            auto begin = cell.find_first_not_of(" \t\r");
+            auto end = cell.find_last_not_of(" \t\r");
+            ret.push_back(begin == std::string::npos ? std::string() : cell.substr(begin, end - begin + 1));
+        }
+        return ret;
+    }
+
+    void readGrid(const std::string& filename, std::vector<std::string>& names, std::vector<std::vector<double>>& points) {
+        std::ifstream ifs(filename);
+        if(!ifs) {
+            throw QCircuitException("Cannot open " + filename);
+        }
+        std::string line;
+        if(!std::getline(ifs, line)) {
+            throw QCircuitException("Empty grid " + filename);
+        }
+        names = splitCsvLine(line);
+        while(std::getline(ifs, line)) {
+            if(line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            std::vector<double> values;
+            for(auto&& cell : splitCsvLine(line)) {
+                values.push_back(std::stod(cell));
+            }
+            if(values.size() != names.size()) {
+                throw QCircuitException("Wrong number of values in " + filename + " : " + line);
+            }
+            points.push_back(values);
+        }
+    }
+
+    std::string readFile(const std::string& filename) {
+        std::ifstream ifs(filename, std::ios::binary);
+        if(!ifs) {
+            throw QCircuitException("Cannot open " + filename);
+        }
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        return ss.str();
+    }
+
+    CircuitTopology makeTopology(const std::string& spec) {
+        auto colon = spec.find(':');
+        auto kind = spec.substr(0, colon);
+        size_t size = (colon == std::string::npos) ? 0 : std::stoul(spec.substr(colon+1));
+        if(kind == "ibmq") {
+            return make_ibmq_topology();
+        }
+        if(kind == "chain" && size >= 2) {
+            return make_chain(size, false);
+        }
+        if(kind == "alltoall" && size >= 2) {
+            return make_alltoall_topology(size);
+        }
+        throw QCircuitException("Unknown topology " + spec);
+    }
+
+    void writeResults(std::ostream& os, const QasmProgram& program, const std::vector<std::string>& names,
+                      const ParameterSweep& sweep, const std::vector<SweepResult>& results) {
+        os << "point";
+        for(auto&& name : names) {
+            os << "," << name;
+        }
+        for(size_t qubit = 0;qubit < program.numberOfQubits();qubit++) {
+            os << ",Z" << qubit;
+        }
+        for(auto&& reg : program.getClassicalRegisters()) {
+            os << "," << reg.name;
+        }
+        os << "\n";
+
+        os.precision(12);
+        for(auto&& result : results) {
+            os << result.point;
+            for(auto value : sweep.getPoints()[result.point]) {
+                os << "," << value;
+            }
+            for(size_t qubit = 0;qubit < program.numberOfQubits();qubit++) {
+                os << "," << result.expectations[qubit];
+            }
+            for(auto&& reg : program.getClassicalRegisters()) {
+                os << "," << program.registerValue(result.bits, reg.name);
+            }
+            os << "\n";
+        }
+    }
+
+    void writeSamples(std::ostream& os, const QasmProgram& program, const ParameterSweep& sweep,
+                      const std::vector<SweepResult>& results) {
+        const size_t size = sweep.getPrefix().size();
+        os << "point,bits\n";
+        for(auto&& result : results) {
+            for(size_t shot = 0;shot < sweep.getShots();shot++) {
+                os << result.point << ",";
+                for(size_t qubit = 0;qubit < program.numberOfQubits();qubit++) {
+                    os << static_cast<int>(result.samples[shot*size + qubit]);
+                }
+                os << "\n";
+            }
+        }
+    }
+
+    int runDriver(int argc, char** argv) {
+        std::map<std::string, std::string> options = {{"--topology", "chain:50"}, {"--shots", "0"}, {"--seed", "0"},
+                                                      {"--cutoff", "1e-8"}};
+        for(int i = 1;i < argc;i++) {
+            std::string key = argv[i];
+            if(key.compare(0, 2, "--") != 0 || i+1 >= argc) {
+                throw QCircuitException("Invalid argument " + key);
+            }
+            options[key] = argv[++i];
+        }
+        if(!options.count("--qasm") || !options.count("--grid")) {
+            throw QCircuitException("Usage: qcircuit_mpi_sweep --qasm FILE --grid FILE [options]");
+        }
+
+        MpiSweepDriver driver;
+        const bool root = (driver.rank() == 0);
+
+        /*
+         * Every rank parses the program and the grid. Only rank 0 reads the prefix,
+         * which is broadcast to the others before the program is lowered on its topology.
+         */
+        std::string checkpoint;
+        if(options.count("--prefix")) {
+            if(root) {
+                checkpoint = readFile(options["--prefix"]);
+            }
+            driver.broadcast(checkpoint);
+        } else {
+            QCircuit fresh(makeTopology(options["--topology"]));
+            fresh.setCutoff(std::stod(options["--cutoff"]));
+            if(options.count("--max-dim")) {
+                fresh.setMaxDim(std::stoi(options["--max-dim"]));
+            }
+            std::stringstream ss;
+            fresh.save(ss);
+            checkpoint = ss.str();
+        }
+        std::stringstream checkpoint_stream(checkpoint);
+        auto prefix = QCircuit::load(checkpoint_stream);
+
+        auto program = QasmProgram::parse(readFile(options["--qasm"]), prefix.getTopology());
+        std::vector<std::string> names;
+        std::vector<std::vector<double>> points;
+        readGrid(options["--grid"], names, points);
+
+        auto sweep = ParameterSweep::fromProgram(prefix, program, names, points);
+        sweep.setShots(std::stoul(options["--shots"])).setSeed(static_cast<std::uint32_t>(std::stoul(options["--seed"])));
+
+        auto results = driver.run(sweep, false);
+        if(!root) {
+            return 0;
+        }
+
+        if(options.count("--output")) {
+            std::ofstream ofs(options["--output"]);
+            writeResults(ofs, program, names, sweep, results);
+        } else {
+            writeResults(std::cout, program, names, sweep, results);
+        }
+        if(options.count("--samples")) {
+            std::ofstream ofs(options["--samples"]);
+            writeSamples(ofs, program, sweep, results);
+        }
+        return 0;
+    }
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+    int status = 0;
+    try {
+        status = runDriver(argc, argv);
+    } catch(const std::exception& e) {
+        std::cerr << "qcircuit_mpi_sweep: " << e.what() << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Finalize();
+    return status;
+}
@@ -0,0 +1,81 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <type_traits>
+#include "qcircuit_exception.hpp"
+
+namespace qcircuit {
+
+    /**
+     * @brief Helpers for the binary checkpoint format of `CircuitTopology` and `QCircuit`.
+     *
+     * Values are written in the native byte order, so checkpoints are meant to be
+     * restored on the same kind of machine.
+     */
+    namespace binary_io {
+
+        /** @brief writes a trivially copyable value as raw bytes. */
+        template<typename T>
+        void writeValue(std::ostream& os, const T& value) {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written");
+            os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template<typename T>
+        T readValue(std::istream& is) {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be read");
+            T value;
+            is.read(reinterpret_cast<char*>(&value), sizeof(T));
+            if(!is) {
+                throw QCircuitException("Invalid checkpoint : Unexpected end of stream");
+            }
+            return value;
+        }
+
+        inline void writeSize(std::ostream& os, size_t value) {
+            writeValue<std::uint64_t>(os, value);
+        }
+
+        inline size_t readSize(std::istream& is) {
+            return static_cast<size_t>(readValue<std::uint64_t>(is));
+        }
+
+        /** @brief writes a length-prefixed string. */
+        inline void writeString(std::ostream& os, const std::string& value) {
+            writeSize(os, value.size());
+            os.write(value.data(), value.size());
+        }
+
+        inline std::string readString(std::istream& is) {
+            std::string value(readSize(is), '\0');
+            is.read(&value[0], value.size());
+            if(!is) {
+                throw QCircuitException("Invalid checkpoint : Unexpected end of stream");
+            }
+            return value;
+        }
+
+        /** @brief writes a magic tag and a format version. */
+        inline void writeHeader(std::ostream& os, const std::string& magic, std::uint32_t version) {
+            os.write(magic.data(), magic.size());
+            writeValue(os, version);
+        }
+
+        /** @brief reads a header written by `writeHeader()` and throws if the tag or the version differs. */
+        inline void readHeader(std::istream& is, const std::string& magic, std::uint32_t version) {
+            std::string tag(magic.size(), '\0');
+            is.read(&tag[0], tag.size());
+            if(!is || tag != magic) {
+                throw QCircuitException("Invalid checkpoint : " + magic + " expected");
+            }
+            if(readValue<std::uint32_t>(is) != version) {
+                throw QCircuitException("Invalid checkpoint : Unsupported version of " + magic);
+            }
+        }
+    } // namespace binary_io
+} // namespace qcircuit
@@ -0,0 +1,117 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <vector>
+#include <exception>
+#include <cstdint>
+#include "qcircuit.hpp"
+#include "gate_spec.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace qcircuit {
+
+    /**
+     * @brief Set of independent circuits processed in parallel, one circuit per thread.
+     *
+     * Circuits are distributed over OpenMP threads with dynamic scheduling,
+     * since circuits in a parameter sweep usually take different times to finish.
+     * Without OpenMP, circuits are processed sequentially.
+     *
+     * See `QCircuit` for the thread-safety contract.
+     */
+    class CircuitPool {
+    private:
+        std::vector<QCircuit> circuits;
+        int num_threads = 0; //!< @brief Number of threads. 0 means the OpenMP default.
+
+    public:
+        explicit CircuitPool(const std::vector<QCircuit>& circuits) : circuits(circuits) {}
+
+        /** @brief constructs `count` copies of `circuit`. */
+        CircuitPool(const QCircuit& circuit, size_t count) : circuits(count, circuit) {}
+
+        size_t size() const {
+            return circuits.size();
+        }
+
+        QCircuit& operator[](size_t index) {
+            return circuits[index];
+        }
+
+        const QCircuit& operator[](size_t index) const {
+            return circuits[index];
+        }
+
+        int getNumThreads() const {
+            return num_threads;
+        }
+
+        /** @brief sets number of threads. 0 means the OpenMP default. */
+        CircuitPool& setNumThreads(int num_threads) {
+            this->num_threads = num_threads;
+            return *this;
+        }
+
+        /**
+         * @brief calls `f(circuit, index)` for each circuit in parallel.
+         *
+         * If some calls throw, the remaining circuits are still processed
+         * and the first exception (in order of index) is rethrown.
+         */
+        template<typename Function>
+        void forEach(Function&& f) {
+            const long count = static_cast<long>(circuits.size());
+            std::vector<std::exception_ptr> errors(count);
+
+#ifdef _OPENMP
+            const int threads = (num_threads > 0) ? num_threads : omp_get_max_threads();
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+#endif
+            for(long i = 0;i < count;i++) {
+                try {
+                    f(circuits[i], static_cast<size_t>(i));
+                } catch(...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+
+            for(auto&& error : errors) {
+                if(error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+
+        /** @brief seeds the circuit `i` with `seed + i`. */
+        void setSeed(std::uint32_t seed) {
+            for(size_t i = 0;i < circuits.size();i++) {
+                circuits[i].setSeed(seed + static_cast<std::uint32_t>(i));
+            }
+        }
+
+        /** @brief applies the same gates to all the circuits (see `QCircuit::applyAll()`). */
+        void applyAll(const GateSpec* specs, size_t count) {
+            forEach([specs, count](QCircuit& circuit, size_t) {
+                circuit.applyAll(specs, count);
+            });
+        }
+
+        void applyAll(const std::vector<GateSpec>& specs) {
+            applyAll(specs.data(), specs.size());
+        }
+
+        /** @brief returns `marginalProbabilities()` of all the circuits. */
+        std::vector<std::vector<double>> marginalProbabilities(int expected = 0) {
+            std::vector<std::vector<double>> ret(circuits.size());
+            forEach([&ret, expected](QCircuit& circuit, size_t i) {
+                ret[i] = circuit.marginalProbabilities(expected);
+            });
+            return ret;
+        }
+    };
+} // namespace qcircuit
@@ -0,0 +1,91 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <cstdint>
+#include "qcircuit.hpp"
+
+namespace qcircuit {
+
+    /**
+     * @brief Initialized circuit from which new circuits are stamped out by copy.
+     *
+     * Constructing a `QCircuit` validates the topology and the initial state,
+     * builds its contraction plan and all the site tensors.
+     * A prototype does this once, and `stamp()` returns a copy (see `QCircuit::fork()`),
+     * which shares the topology, the contraction plan and the storage of the tensors.
+     * Stamps share the physical indices of the prototype, so they can be compared by `overlap()`,
+     * unless they are stamped with other indices.
+     *
+     * To run many short circuits one after another, `QCircuit::reset()` on one stamp
+     * is cheaper still, since it does not even copy the circuit.
+     */
+    class CircuitPrototype {
+    private:
+        QCircuit prototype;
+
+    public:
+        /** @brief takes the current state of `circuit` as the initial state of the stamps. */
+        explicit CircuitPrototype(const QCircuit& circuit) : prototype(circuit.fork()) {
+            prototype.markInitialState();
+        }
+
+        CircuitPrototype(std::shared_ptr<const CircuitTopology> shared_topology,
+                         const std::vector<std::pair<std::complex<double>, std::complex<double>>>& init_qubits,
+                         const std::vector<Index>& physical_indices = std::vector<Index>()) :
+            prototype(shared_topology, init_qubits, physical_indices) {}
+
+        CircuitPrototype(const CircuitTopology& topology,
+                         const std::vector<std::pair<std::complex<double>, std::complex<double>>>& init_qubits,
+                         const std::vector<Index>& physical_indices = std::vector<Index>()) :
+            prototype(topology, init_qubits, physical_indices) {}
+
+        /** @brief prototype of |000 ... 000>. */
+        explicit CircuitPrototype(std::shared_ptr<const CircuitTopology> shared_topology,
+                                  const std::vector<Index>& physical_indices = std::vector<Index>()) :
+            prototype(shared_topology, physical_indices) {}
+
+        explicit CircuitPrototype(const CircuitTopology& topology,
+                                  const std::vector<Index>& physical_indices = std::vector<Index>()) :
+            prototype(topology, physical_indices) {}
+
+        const QCircuit& getPrototype() const {
+            return prototype;
+        }
+
+        const std::vector<Index>& physicalIndices() const {
+            return prototype.site();
+        }
+
+        /** @brief returns a new circuit whose random engine is seeded from `std::random_device`. */
+        QCircuit stamp() const {
+            return prototype.fork(std::random_device()());
+        }
+
+        /** @brief returns a new circuit whose random engine is seeded with `seed`. */
+        QCircuit stamp(std::uint32_t seed) const {
+            return prototype.fork(seed);
+        }
+
+        /** @brief returns a new circuit with the physical indices `physical_indices`. */
+        QCircuit stampWithIndices(const std::vector<Index>& physical_indices, std::uint32_t seed) const {
+            auto ret = prototype.fork(seed);
+            ret.replacePhysicalIndices(physical_indices);
+            return ret;
+        }
+
+        /** @brief returns a new circuit with new physical indices, independent of the other stamps. */
+        QCircuit stampWithFreshIndices(std::uint32_t seed) const {
+            std::vector<Index> indices;
+            indices.reserve(prototype.size());
+            for(size_t i = 0;i < prototype.size();i++) {
+                indices.emplace_back(2, "SiteInd");
+            }
+            return stampWithIndices(indices, seed);
+        }
+    };
+} // namespace qcircuit
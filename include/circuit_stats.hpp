@@ -0,0 +1,102 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <typeindex>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+namespace qcircuit {
+
+    /**
+     * @brief Counters of the hot paths of `QCircuit`.
+     *
+     * The counters are recorded only if `QCIRCUIT_STATS` is defined at compile time
+     * (the CMake option of the same name), otherwise all the recording calls in `QCircuit`
+     * are compiled out and the counters stay zero.
+     */
+    struct CircuitStats {
+        /** @brief Number and total time of decompositions in a bucket of `Psi` sizes. */
+        struct DecompositionBucket {
+            size_t count = 0;
+            double seconds = 0.0;
+        };
+
+        std::map<std::type_index, size_t> gate_counts; //!< @brief Number of applied gates per gate type.
+
+        size_t decompositions = 0;        //!< @brief Number of `decomposePsi()` calls.
+        double decomposition_seconds = 0; //!< @brief Total time spent in `decomposePsi()`.
+        /**
+         * @brief Decompositions by the number of elements of `Psi`.
+         * The key `k` is the bucket of sizes in [2^k, 2^(k+1)).
+         */
+        std::map<size_t, DecompositionBucket> decomposition_histogram;
+
+        std::vector<long> max_bond_dims;  //!< @brief Largest bond dimension of each link so far.
+        double cumulative_truncation_error = 0; //!< @brief Sum of truncation errors of all the decompositions.
+
+        size_t cursor_hops = 0; //!< @brief Number of cursor shifts.
+
+        static constexpr bool enabled() {
+#ifdef QCIRCUIT_STATS
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /** @brief clears all the counters. Bond dimensions are reset to `current_bond_dims`. */
+        void reset(const std::vector<long>& current_bond_dims) {
+            *this = CircuitStats();
+            max_bond_dims = current_bond_dims;
+        }
+
+        void recordGate(const std::type_index& type) {
+            gate_counts[type]++;
+        }
+
+        void recordDecomposition(size_t link, size_t psi_size, long bond_dim, double truncation_error, double seconds) {
+            size_t bucket = 0;
+            while((psi_size >> (bucket+1)) != 0) {
+                bucket++;
+            }
+
+            decompositions++;
+            decomposition_seconds += seconds;
+            decomposition_histogram[bucket].count++;
+            decomposition_histogram[bucket].seconds += seconds;
+            max_bond_dims[link] = std::max(max_bond_dims[link], bond_dim);
+            cumulative_truncation_error += truncation_error;
+        }
+
+        void recordCursorHop() {
+            cursor_hops++;
+        }
+
+        /** @brief returns readable name of a gate type, e.g. "CNOT". */
+        static std::string gateName(const std::type_index& type) {
+            std::string ret = type.name();
+#if defined(__GNUG__)
+            int status = 0;
+            std::unique_ptr<char, void(*)(void*)> demangled(
+                abi::__cxa_demangle(type.name(), nullptr, nullptr, &status), std::free);
+            if(status == 0) {
+                ret = demangled.get();
+            }
+#endif
+            const std::string prefix = "qcircuit::";
+            if(ret.compare(0, prefix.size(), prefix) == 0) {
+                ret = ret.substr(prefix.size());
+            }
+            return ret;
+        }
+    };
+} // namespace qcircuit
@@ -8,13 +8,27 @@
 #include <queue>
 #include <algorithm>
 #include <sstream>
+#include <limits>
+#include <array>
+#include <memory>
+#include <mutex>
 #include <cassert>
 #include "qcircuit_exception.hpp"
+#include "binary_io.hpp"
 
 namespace qcircuit {
 
+    class ContractionPlan;
+
     /**
      * @brief class to represent circuit topology
+     *
+     * After all the links are generated, `finalize()` can be called to precompute
+     * all-pairs routing tables and a dense link-ID table.
+     * Then route and link lookups do not run BFS or linear searches any more,
+     * and no link can be generated.
+     * The contraction plan of a finalized topology is built once and shared with its copies
+     * (see `getContractionPlan()`).
      */
     class CircuitTopology {
     public:
@@ -25,20 +39,73 @@ namespace qcircuit {
             Neighbor(size_t site, size_t link) : site(site), link(link) {}
         };
 
+        /** @brief Contiguous range of neighbors of a site, returned by `neighborsOf()`. */
+        class NeighborRange {
+        private:
+            const Neighbor* first;
+            const Neighbor* last;
+
+        public:
+            NeighborRange(const Neighbor* first, const Neighbor* last) : first(first), last(last) {}
+
+            const Neighbor* begin() const {
+                return first;
+            }
+
+            const Neighbor* end() const {
+                return last;
+            }
+
+            size_t size() const {
+                return static_cast<size_t>(last - first);
+            }
+
+            bool empty() const {
+                return first == last;
+            }
+
+            const Neighbor& operator[](size_t i) const {
+                assert(i < size());
+                return first[i];
+            }
+        };
+
     private:
         const size_t num_bits; //!< @brief Number of qubits
         size_t num_links; //!< @brief Number of links
-        std::vector<std::vector<Neighbor>> neighbors_list; //!< @brief List of neighboring sites of each site.
+        /* Adjacency list in CSR (compressed sparse row) format:
+         * the neighbors of site i are `adjacency[offsets[i]]`, ..., `adjacency[offsets[i+1]-1]`.
+         */
+        std::vector<size_t> offsets;     //!< @brief Start of the neighbors of each site. The size is `num_bits+1`.
+        std::vector<Neighbor> adjacency; //!< @brief Neighbors of all the sites in order of site.
+
+        static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+        bool finalized = false; //!< @brief Whether the tables below are built.
+        std::vector<size_t> next_hop;   //!< @brief `next_hop[i*num_bits + j]` is the neighbor of i on a shortest path to j.
+        std::vector<size_t> distance;   //!< @brief `distance[i*num_bits + j]` is the shortest path length, or `NONE`.
+        std::vector<size_t> link_table; //!< @brief `link_table[i*num_bits + j]` is the link ID between i and j, or `NONE`.
+
+        /** @brief Contraction plan built on the first request. */
+        struct PlanCache {
+            std::once_flag built;
+            std::shared_ptr<const ContractionPlan> plan;
+        };
+        std::shared_ptr<PlanCache> plan_cache; //!< @brief Shared with the copies once finalized.
 
     public:
         CircuitTopology(size_t num_bits) : num_bits(num_bits),
                                            num_links(0),
-                                           neighbors_list(num_bits) {}
+                                           offsets(num_bits+1, 0) {}
 
         /**
          * @brief generates a link between `site1` and `site2`.
          */
         void generateLink(size_t site1, size_t site2) {
+            if(finalized) {
+                throw QCircuitException("Link can't be generated : Topology is already finalized");
+            }
+
             /* Check invalid site index */
             if(site1 >= num_bits || site2 >= num_bits) {
                 std::stringstream ss;
@@ -61,9 +128,10 @@ namespace qcircuit {
 
             /* Check whether the specified link already exists. */
             {
-                auto itr = std::find_if(neighbors_list[site1].begin(), neighbors_list[site1].end(),
+                auto v = neighborsOf(site1);
+                auto itr = std::find_if(v.begin(), v.end(),
                                         [&](const Neighbor& nei) { return nei.site == site2; });
-                if(itr != neighbors_list[site1].end()) {
+                if(itr != v.end()) {
                     std::stringstream ss;
                     ss << "Link can't be generated between (" << site1 << ", " << site2
                        << ") : Link already exists";
@@ -71,8 +139,8 @@ namespace qcircuit {
                 }
             }
 
-            neighbors_list[site1].emplace_back(site2, num_links);
-            neighbors_list[site2].emplace_back(site1, num_links);
+            appendNeighbor(site1, Neighbor(site2, num_links));
+            appendNeighbor(site2, Neighbor(site1, num_links));
             num_links++;
         }
 
@@ -80,7 +148,11 @@ namespace qcircuit {
          * @brief returns whether a link exists between `site1` and `site2`.
          */
         bool hasLinkBetween(size_t site1, size_t site2) const {
-            auto v = this->neighbors_list[site1];
+            if(finalized) {
+                return link_table[site1*num_bits + site2] != NONE;
+            }
+
+            auto v = neighborsOf(site1);
             auto find_result = std::find_if(v.begin(), v.end(), [&site2] (const Neighbor& x) {
                                                                     return x.site == site2;
                                                                 });
@@ -91,7 +163,11 @@ namespace qcircuit {
          * @brief returns a link ID between `site1` and `site2`.
          */
         size_t getLinkIdBetween(size_t site1, size_t site2) const {
-            auto v = this->neighbors_list[site1];
+            if(finalized && link_table[site1*num_bits + site2] != NONE) {
+                return link_table[site1*num_bits + site2];
+            }
+
+            auto v = neighborsOf(site1);
             auto find_result = std::find_if(v.begin(), v.end(), [&site2] (const Neighbor& x) {
                                                                     return x.site == site2;
                                                                 });
@@ -112,28 +188,169 @@ namespace qcircuit {
             return this->num_bits;
         }
 
-        const std::vector<Neighbor>& neighborsOf(size_t index) const {
-            return this->neighbors_list[index];
+        NeighborRange neighborsOf(size_t index) const {
+            assert(index < num_bits);
+            const Neighbor* data = this->adjacency.data();
+            return NeighborRange(data + offsets[index], data + offsets[index+1]);
+        }
+
+        /**
+         * @brief builds the routing and link-ID tables and freezes the topology.
+         *
+         * BFS is performed once from every site, so this takes O(N (N + L)) time and O(N^2) memory.
+         * Calling this function again does nothing.
+         */
+        void finalize() {
+            if(finalized) {
+                return;
+            }
+
+            const size_t n = num_bits;
+            next_hop.assign(n*n, NONE);
+            distance.assign(n*n, NONE);
+            link_table.assign(n*n, NONE);
+
+            for(size_t i = 0;i < n;i++) {
+                for(auto&& neighbor : neighborsOf(i)) {
+                    link_table[i*n + neighbor.site] = neighbor.link;
+                }
+            }
+
+            // BFS from `root`: the parent of `site` in the BFS tree is the next hop from `site` to `root`.
+            std::queue<size_t> queue;
+            for(size_t root = 0;root < n;root++) {
+                distance[root*n + root] = 0;
+                next_hop[root*n + root] = root;
+                queue.push(root);
+
+                while(!queue.empty()) {
+                    auto site = queue.front();
+                    queue.pop(); // pop() returns nothing.
+
+                    for(auto&& neighbor : neighborsOf(site)) {
+                        if(distance[neighbor.site*n + root] == NONE) {
+                            distance[neighbor.site*n + root] = distance[site*n + root] + 1;
+                            next_hop[neighbor.site*n + root] = site;
+                            queue.push(neighbor.site);
+                        }
+                    }
+                }
+            }
+
+            plan_cache = std::make_shared<PlanCache>();
+            finalized = true;
+        }
+
+        /**
+         * @brief returns the contraction plan of this topology, which must be finalized.
+         *
+         * The plan is built on the first call, and the copies of this topology share it,
+         * so the circuits on the same topology build it only once. This is thread-safe.
+         */
+        std::shared_ptr<const ContractionPlan> getContractionPlan() const;
+
+        /** @brief returns a finalized copy of this topology (see `finalize()`). */
+        CircuitTopology finalizedCopy() const {
+            CircuitTopology ret(*this);
+            ret.finalize();
+            return ret;
+        }
+
+        bool isFinalized() const {
+            return finalized;
+        }
+
+        /**
+         * @brief writes the sites and the links to `os` in a binary format.
+         *
+         * Only the links are stored; routing tables are rebuilt by `finalize()` after `read()`.
+         */
+        void write(std::ostream& os) const {
+            /* Endpoints of each link, in order of link ID */
+            std::vector<std::pair<size_t, size_t>> links(num_links);
+            for(size_t i = 0;i < num_bits;i++) {
+                for(auto&& neighbor : neighborsOf(i)) {
+                    if(i < neighbor.site) {
+                        links[neighbor.link] = std::make_pair(i, neighbor.site);
+                    }
+                }
+            }
+
+            binary_io::writeHeader(os, "QCTOPO", 1);
+            binary_io::writeSize(os, num_bits);
+            binary_io::writeSize(os, num_links);
+            for(auto&& link : links) {
+                binary_io::writeSize(os, link.first);
+                binary_io::writeSize(os, link.second);
+            }
+            binary_io::writeValue<std::uint8_t>(os, finalized);
+        }
+
+        /**
+         * @brief reads a topology written by `write()`.
+         *
+         * Links are generated in order of their IDs, so link IDs and neighbor orders are restored.
+         */
+        static CircuitTopology read(std::istream& is) {
+            binary_io::readHeader(is, "QCTOPO", 1);
+            CircuitTopology ret(binary_io::readSize(is));
+            const size_t num_links = binary_io::readSize(is);
+            for(size_t k = 0;k < num_links;k++) {
+                size_t site1 = binary_io::readSize(is);
+                size_t site2 = binary_io::readSize(is);
+                ret.generateLink(site1, site2);
+            }
+            if(binary_io::readValue<std::uint8_t>(is)) {
+                ret.finalize();
+            }
+            return ret;
+        }
+
+        /**
+         * @brief returns the number of cursor shifts along `getRoute(origin, destination)`,
+         * i.e. the size of the returned route.
+         *
+         * No allocation is performed on a finalized topology.
+         */
+        size_t getRouteLength(std::pair<size_t, size_t> origin, std::pair<size_t, size_t> destination) const {
+            if(!finalized) {
+                return getRoute(origin, destination).size();
+            }
+            if(coversAny(origin, destination)) {
+                return 0;
+            }
+            auto ends = nearestPair(origin, destination);
+            return distance[ends.first*num_bits + ends.second];
         }
 
 
         /**
          * @brief Searches the shortest route from `origin` to `destination`.
          *
-         * Breadth First Search algorithm is used.
+         * Breadth First Search algorithm is used, or the routing table if finalized.
          */
         std::vector<size_t> getRoute(std::pair<size_t, size_t> origin, std::pair<size_t, size_t> destination) const {
+            // If not necessary to move (at least one of destination is the same as origins)
+            if(coversAny(origin, destination)) {
+                return std::vector<size_t>();
+            }
+
+            if(finalized) {
+                auto ends = nearestPair(origin, destination);
+                std::vector<size_t> result;
+                result.reserve(distance[ends.first*num_bits + ends.second]);
+                for(size_t site = ends.first;site != ends.second;) {
+                    site = next_hop[site*num_bits + ends.second];
+                    result.push_back(site);
+                }
+                return result;
+            }
+
             static const int NOT_YET_REACHED = -1;
             std::vector<int> back_to(num_bits, NOT_YET_REACHED);
             // back_to[i] points which neighboring site we go back at ith site
             // to reach `origin` in the shortest path.
 
-            // If not necessary to move (at least one of destination is the same as origins)
-            if((origin.first == destination.first ||  origin.first == destination.second) ||
-               (origin.second == destination.first || origin.second == destination.second)) {
-                return std::vector<size_t>();
-            }
-
             std::queue<size_t> queue;
             queue.push(origin.first);
             back_to[origin.first] = origin.first;
@@ -148,7 +365,7 @@ namespace qcircuit {
                     break;
                 }
 
-                for(auto neighbor : neighbors_list[site]) {
+                for(auto neighbor : neighborsOf(site)) {
                     if(back_to[neighbor.site] == NOT_YET_REACHED) {
                         back_to[neighbor.site] = site;
                         queue.push(neighbor.site);
@@ -182,7 +399,8 @@ namespace qcircuit {
          * @brief Find the shortest swapping path to move `target` to
          * one neighboring site of `origin`
          *
-         * Breadth First Search algorithm is used. Returned vector contains `target`
+         * Breadth First Search algorithm is used, or the routing table if finalized.
+         * Returned vector contains `target`
          * and does not contain `origin`.
          * If `target` is already a neighbor of `origin`, returned vector contains only `target`.
          *
@@ -190,15 +408,29 @@ namespace qcircuit {
          * this function could be combined with it.
          */
         std::vector<size_t> getSwapPath(size_t origin, size_t target) const {
+            if(origin == target) {
+                assert(false && "Unintended call (unnecessary to swap)");
+            }
+
+            if(finalized) {
+                if(distance[target*num_bits + origin] == NONE) {
+                    std::stringstream ss;
+                    ss << "Path from " << target << " to " << origin << " not found";
+                    throw QCircuitException(ss.str());
+                }
+                std::vector<size_t> result;
+                result.reserve(distance[target*num_bits + origin]);
+                for(size_t site = target;site != origin;site = next_hop[site*num_bits + origin]) {
+                    result.push_back(site);
+                }
+                return result;
+            }
+
             static const int NOT_YET_REACHED = -1;
             std::vector<int> back_to(num_bits, NOT_YET_REACHED);
             // back_to[i] points which neighboring site we go back at ith site
             // to reach one neighbor of `destination` in the shortest path.
 
-            if(origin == target) {
-                assert(false && "Unintended call (unnecessary to swap)");
-            }
-
             std::queue<size_t> queue;
             queue.push(origin);
             back_to[origin] = origin;
@@ -211,7 +443,7 @@ namespace qcircuit {
                     break;
                 }
 
-                for(auto neighbor : neighbors_list[site]) {
+                for(auto neighbor : neighborsOf(site)) {
                     if(back_to[neighbor.site] == NOT_YET_REACHED) {
                         back_to[neighbor.site] = site;
                         queue.push(neighbor.site);
@@ -231,13 +463,62 @@ namespace qcircuit {
         }
 
 
+    private:
+        /** @brief appends `neighbor` at the end of the neighbors of `site`, keeping the CSR layout. */
+        void appendNeighbor(size_t site, const Neighbor& neighbor) {
+            adjacency.insert(adjacency.begin() + offsets[site+1], neighbor);
+            for(size_t i = site+1;i <= num_bits;i++) {
+                offsets[i]++;
+            }
+        }
+
+        /** @brief returns whether any site of `destination` is one of `origin`. */
+        static bool coversAny(std::pair<size_t, size_t> origin, std::pair<size_t, size_t> destination) {
+            return (origin.first == destination.first ||  origin.first == destination.second) ||
+                   (origin.second == destination.first || origin.second == destination.second);
+        }
+
+        /**
+         * @brief returns the pair of a site of `origin` and a site of `destination` with the shortest distance
+         * on a finalized topology. Throws if `destination` is unreachable.
+         */
+        std::pair<size_t, size_t> nearestPair(std::pair<size_t, size_t> origin, std::pair<size_t, size_t> destination) const {
+            assert(finalized);
+            std::pair<size_t, size_t> ret(origin.first, destination.first);
+            for(auto o : {origin.first, origin.second}) {
+                for(auto d : {destination.first, destination.second}) {
+                    if(distance[o*num_bits + d] < distance[ret.first*num_bits + ret.second]) {
+                        ret = std::make_pair(o, d);
+                    }
+                }
+            }
+
+            if(distance[ret.first*num_bits + ret.second] == NONE) {
+                std::stringstream ss;
+                ss << "Path to (" << destination.first << ", "
+                   << destination.second << ") not found";
+                throw QCircuitException(ss.str());
+            }
+            return ret;
+        }
+
+    public:
         /**
          * @brief returns true if the circuit is a connected graph,
          * i.e. there is a path between every pair of qubits (vertices).
          *
-         * Breadth First Search algorithm is used.
+         * Breadth First Search algorithm is used, or the distance table in O(N) time if finalized.
          */
         bool isConnectedGraph() const {
+            if(finalized) {
+                for(size_t site = 0;site < num_bits;site++) {
+                    if(distance[site*num_bits] == NONE) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
             std::vector<bool> reached(num_bits, false);
 
             std::queue<size_t> queue;
@@ -248,7 +529,7 @@ namespace qcircuit {
                 auto site = queue.front();
                 queue.pop(); // pop() returns nothing.
 
-                for(auto neighbor : neighbors_list[site]) {
+                for(auto neighbor : neighborsOf(site)) {
                     if(!reached[neighbor.site]) {
                         reached[neighbor.site] = true;
                         queue.push(neighbor.site);
@@ -277,7 +558,7 @@ namespace qcircuit {
             stream << "    graph[layout=" << layout << "]" << std::endl;
             stream << "    node[shape=" << shape << "]" << std::endl << std::endl;
             for(size_t i = 0;i < num_bits;i++) {
-                for(const auto& neighbor : neighbors_list[i]) {
+                for(const auto& neighbor : neighborsOf(i)) {
                     if(i > neighbor.site) {
                         stream << "    " << i << " -- " << neighbor.site << ";" << std::endl;
                     }
@@ -289,3 +570,5 @@ namespace qcircuit {
         }
     };
 } // namespace qcircuit
+
+#include "contraction_plan.hpp" // defines CircuitTopology::getContractionPlan()
@@ -0,0 +1,174 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cassert>
+#include "circuit_topology.hpp"
+
+namespace qcircuit {
+
+    /**
+     * @brief Contraction tree of a tensor network laid on `CircuitTopology`.
+     *
+     * Each site is a leaf, and each internal node contracts the tensors of its two children.
+     * The tree is built greedily: among the pairs of clusters sharing at least one link,
+     * the pair whose merged cluster has the fewest open links (links to the outside) is merged first,
+     * and ties are broken by the smaller merged cluster to keep the tree balanced.
+     * The number of open links bounds the rank of the intermediate tensor,
+     * so this keeps the intermediate tensors small on loopy topologies,
+     * unlike contracting the sites one by one in index order.
+     *
+     * Internal nodes of the same height do not depend on each other,
+     * so `contract()` processes them in parallel with OpenMP.
+     *
+     * The plan depends only on the topology, so it is built once per finalized topology
+     * and shared among the circuits on it (see `CircuitTopology::getContractionPlan()`).
+     */
+    class ContractionPlan {
+    public:
+        /** @brief Node of contraction tree. The first `numberOfSites()` nodes are the leaves. */
+        struct Node {
+            size_t left;       //!< @brief Child node ID. Unused for leaves.
+            size_t right;      //!< @brief Child node ID. Unused for leaves.
+            size_t open_links; //!< @brief Number of links between the sites under this node and the others.
+        };
+
+    private:
+        size_t num_sites;
+        std::vector<Node> nodes;
+        std::vector<std::vector<size_t>> levels; //!< @brief Internal nodes grouped by height.
+
+    public:
+        explicit ContractionPlan(const CircuitTopology& topology) : num_sites(topology.numberOfBits()) {
+            const size_t n = num_sites;
+            nodes.reserve(2*n);
+
+            /* Cluster slots initially hold one site each.
+             * `shared[a][b]` is the number of links between the clusters `a` and `b`.
+             */
+            std::vector<std::vector<size_t>> shared(n, std::vector<size_t>(n, 0));
+            std::vector<size_t> open(n, 0), cluster_size(n, 1), node_of(n), height(2*n, 0);
+            std::vector<bool> active(n, true);
+            for(size_t i = 0;i < n;i++) {
+                for(auto&& neighbor : topology.neighborsOf(i)) {
+                    shared[i][neighbor.site]++;
+                    open[i]++;
+                }
+                nodes.push_back(Node{i, i, open[i]});
+                node_of[i] = i;
+            }
+
+            for(size_t step = 0;step + 1 < n;step++) {
+                size_t best_a = n, best_b = n;
+                std::pair<size_t, size_t> best_score;
+                for(size_t a = 0;a < n;a++) {
+                    if(!active[a]) {
+                        continue;
+                    }
+                    for(size_t b = a+1;b < n;b++) {
+                        if(!active[b] || shared[a][b] == 0) {
+                            continue;
+                        }
+                        std::pair<size_t, size_t> score(open[a] + open[b] - 2*shared[a][b],
+                                                        cluster_size[a] + cluster_size[b]);
+                        if(best_a == n || score < best_score) {
+                            best_a = a;
+                            best_b = b;
+                            best_score = score;
+                        }
+                    }
+                }
+
+                if(best_a == n) {
+                    throw QCircuitException("Invalid circuit topology : Some nodes are unreachable");
+                }
+
+                /* Merge the cluster `best_b` into `best_a` */
+                const size_t a = best_a, b = best_b;
+                const size_t node = nodes.size();
+                nodes.push_back(Node{node_of[a], node_of[b], best_score.first});
+                height[node] = std::max(height[node_of[a]], height[node_of[b]]) + 1;
+                if(levels.size() < height[node]) {
+                    levels.resize(height[node]);
+                }
+                levels[height[node]-1].push_back(node);
+
+                for(size_t c = 0;c < n;c++) {
+                    shared[a][c] += shared[b][c];
+                    shared[c][a] = shared[a][c];
+                    shared[b][c] = shared[c][b] = 0;
+                }
+                shared[a][a] = 0;
+                open[a] = best_score.first;
+                cluster_size[a] += cluster_size[b];
+                node_of[a] = node;
+                active[b] = false;
+            }
+        }
+
+        size_t numberOfSites() const {
+            return num_sites;
+        }
+
+        const std::vector<Node>& getNodes() const {
+            return nodes;
+        }
+
+        /** @brief returns the internal node IDs grouped by height, from the bottom. */
+        const std::vector<std::vector<size_t>>& getLevels() const {
+            return levels;
+        }
+
+        /** @brief returns the largest number of open links among all the intermediate tensors. */
+        size_t maxOpenLinks() const {
+            size_t ret = 0;
+            for(size_t k = num_sites;k < nodes.size();k++) {
+                ret = std::max(ret, nodes[k].open_links);
+            }
+            return ret;
+        }
+
+        /**
+         * @brief contracts `leaves` (one tensor per site) along the tree and returns the result.
+         *
+         * `Tensor` needs to be default-constructible and to implement `operator*` as contraction.
+         * Children are released as soon as their parent is computed to reduce the peak memory.
+         */
+        template<typename Tensor>
+        Tensor contract(std::vector<Tensor> leaves) const {
+            assert(leaves.size() == num_sites);
+            if(num_sites == 0) {
+                return Tensor();
+            }
+
+            std::vector<Tensor> partial(std::move(leaves));
+            partial.resize(nodes.size());
+            for(auto&& level : levels) {
+                const long count = static_cast<long>(level.size());
+#pragma omp parallel for schedule(dynamic)
+                for(long k = 0;k < count;k++) {
+                    const Node& node = nodes[level[k]];
+                    partial[level[k]] = partial[node.left] * partial[node.right];
+                    partial[node.left] = Tensor();
+                    partial[node.right] = Tensor();
+                }
+            }
+
+            return partial.back();
+        }
+    };
+
+    inline std::shared_ptr<const ContractionPlan> CircuitTopology::getContractionPlan() const {
+        if(!finalized) {
+            throw QCircuitException("Contraction plan can't be built : Topology is not finalized");
+        }
+        std::call_once(plan_cache->built, [this]() {
+            plan_cache->plan = std::make_shared<const ContractionPlan>(*this);
+        });
+        return plan_cache->plan;
+    }
+} // namespace qcircuit
@@ -0,0 +1,273 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <limits>
+#include <cassert>
+#include "circuit_topology.hpp"
+#include "quantum_gate.hpp"
+#include "qcircuit_exception.hpp"
+
+namespace qcircuit {
+
+    /**
+     * @brief Reorders a gate list to reduce the decompositions and the cursor travel of `QCircuit`.
+     *
+     * A cursor shift decomposes (SVD) the merged wave function only if a gate has been applied
+     * at the cursor since the last shift (see `QCircuit::shiftCursorTo()`);
+     * the other shifts of a move only contract the tensors.
+     * So every move away from a modified cursor costs one decomposition,
+     * and applying gates in program order may move the cursor back and forth across the circuit.
+     * This scheduler keeps the order of non-commuting gates and greedily picks,
+     * among the gates whose predecessors are already scheduled, the one reachable
+     * with the fewest decompositions, and then with the fewest cursor shifts.
+     *
+     * Two gates are regarded as commuting if they act on disjoint sites,
+     * or if both of them are diagonal in the computational basis.
+     *
+     * The cost model follows `QCircuit::apply()`:
+     * a two-site gate moves the cursor onto its sites, and a one-site gate costs nothing
+     * if it is unitary (absorbed into the site tensor) or its site is under the cursor.
+     * Every gate applied at the cursor modifies the merged wave function.
+     */
+    class CursorScheduler {
+    public:
+        using Cursor = std::pair<size_t, size_t>;
+
+        /** @brief Decompositions and cursor shifts of applying a gate list. */
+        struct Cost {
+            size_t decompositions; //!< @brief Cursor shifts which decompose the merged wave function.
+            size_t shifts;         //!< @brief All the cursor shifts.
+
+            bool operator<(const Cost& other) const {
+                return decompositions < other.decompositions
+                    || (decompositions == other.decompositions && shifts < other.shifts);
+            }
+        };
+
+        /** @brief Cost before and after scheduling. */
+        struct Report {
+            size_t shifts_before;         //!< @brief Cursor shifts in the original order.
+            size_t shifts_after;          //!< @brief Cursor shifts in the scheduled order.
+            size_t decompositions_before; //!< @brief Decompositions in the original order.
+            size_t decompositions_after;  //!< @brief Decompositions in the scheduled order.
+        };
+
+        /** @brief Cursor position and whether the merged wave function has been modified there. */
+        struct State {
+            Cursor cursor;
+            bool dirty;
+        };
+
+    private:
+        const CircuitTopology& topology;
+
+        /** @brief Sites of a gate and whether the cursor has to be moved onto them. */
+        struct GateInfo {
+            size_t site1;
+            size_t site2;      //!< @brief For one-site gates, the dummy neighbor used if the cursor moves.
+            bool two_site;
+            bool needs_cursor; //!< @brief false if the gate can be applied wherever the cursor is.
+            bool diagonal;     //!< @brief true if diagonal in the computational basis.
+        };
+
+        GateInfo inspect(const Gate& gate) const {
+            if(auto two_site = dynamic_cast<const TwoSiteGate*>(&gate)) {
+                auto u = two_site->matrix();
+                bool diagonal = true;
+                for(int i = 0;i < 4;i++) {
+                    for(int j = 0;j < 4;j++) {
+                        diagonal = diagonal && (i == j || u[4*i + j] == 0.0);
+                    }
+                }
+                return GateInfo{two_site->site1, two_site->site2, true, true, diagonal};
+            }
+
+            auto one_site = dynamic_cast<const OneSiteGate*>(&gate);
+            if(one_site == nullptr) {
+                throw QCircuitException("Unsupported gate type for scheduling");
+            }
+            auto u = one_site->matrix();
+            bool diagonal = (u[1] == 0.0 && u[2] == 0.0);
+            size_t dummy = topology.neighborsOf(one_site->site)[0].site;
+            return GateInfo{one_site->site, dummy, false, !one_site->isUnitary(), diagonal};
+        }
+
+        static bool covers(const Cursor& cursor, size_t site) {
+            return cursor.first == site || cursor.second == site;
+        }
+
+        /**
+         * @brief returns the cost to apply `info` and updates `state`
+         * in the same way as `QCircuit::apply()`.
+         */
+        Cost advance(const GateInfo& info, State& state) const {
+            auto& cursor = state.cursor;
+            if(!info.needs_cursor && !covers(cursor, info.site1)) {
+                return Cost{0, 0}; // absorbed into the site tensor
+            }
+            if(!info.needs_cursor || (!info.two_site && covers(cursor, info.site1))
+               || (covers(cursor, info.site1) && covers(cursor, info.site2))) {
+                state.dirty = true; // applied at the cursor
+                return Cost{0, 0};
+            }
+
+            // Same as QCircuit::moveCursorTo(): follow the route, then one more shift.
+            // Only the first shift decomposes, since the others start from a merged wave function.
+            Cost ret{state.dirty ? 1u : 0u, topology.getRouteLength(cursor, std::make_pair(info.site1, info.site2)) + 1};
+            cursor = std::make_pair(info.site1, info.site2);
+            state.dirty = true;
+            return ret;
+        }
+
+        /** @brief returns the cost to apply `info` without changing `state`. */
+        Cost cost(const GateInfo& info, State state) const {
+            return advance(info, state);
+        }
+
+        /** @brief returns the cost to apply `gates` in the given order. */
+        Cost total(State state, const std::vector<const Gate*>& gates) const {
+            Cost ret{0, 0};
+            for(auto gate : gates) {
+                auto c = advance(inspect(*gate), state);
+                ret.decompositions += c.decompositions;
+                ret.shifts += c.shifts;
+            }
+            return ret;
+        }
+
+    public:
+        /**
+         * @brief constructs a scheduler on `topology`, which must outlive this object.
+         *
+         * A finalized topology (see `CircuitTopology::finalize()`) is recommended,
+         * since route lengths are evaluated for every ready gate.
+         */
+        explicit CursorScheduler(const CircuitTopology& topology) : topology(topology) {}
+
+        /** @brief returns the number of cursor shifts to apply `gates` in the given order from `cursor`. */
+        size_t countShifts(Cursor cursor, const std::vector<const Gate*>& gates) const {
+            return total(State{cursor, false}, gates).shifts;
+        }
+
+        /**
+         * @brief returns the number of decompositions to apply `gates` in the given order from `cursor`.
+         *
+         * `dirty` tells whether the merged wave function has been modified at `cursor`.
+         */
+        size_t countDecompositions(Cursor cursor, const std::vector<const Gate*>& gates, bool dirty = false) const {
+            return total(State{cursor, dirty}, gates).decompositions;
+        }
+
+        /**
+         * @brief returns the scheduled order of `gates` as indices into `gates`,
+         * starting with the cursor at `cursor`.
+         *
+         * `dirty` tells whether the merged wave function has been modified at `cursor`.
+         */
+        std::vector<size_t> schedule(Cursor cursor, const std::vector<const Gate*>& gates, bool dirty = false) const {
+            const size_t num_gates = gates.size();
+
+            std::vector<GateInfo> info;
+            info.reserve(num_gates);
+            for(auto gate : gates) {
+                info.push_back(inspect(*gate));
+            }
+
+            /* Build dependency graph.
+             * A gate depends on the last non-diagonal gate on each of its sites,
+             * and a non-diagonal gate also depends on the diagonal gates following it.
+             */
+            static const size_t NONE = std::numeric_limits<size_t>::max();
+            std::vector<size_t> last_non_diagonal(topology.numberOfBits(), NONE);
+            std::vector<std::vector<size_t>> diagonals_since(topology.numberOfBits());
+            std::vector<std::vector<size_t>> successors(num_gates);
+            std::vector<size_t> num_predecessors(num_gates, 0);
+
+            auto add_edge = [&](size_t from, size_t to) {
+                successors[from].push_back(to);
+                num_predecessors[to]++;
+            };
+
+            for(size_t j = 0;j < num_gates;j++) {
+                std::vector<size_t> sites = {info[j].site1};
+                if(info[j].two_site) {
+                    sites.push_back(info[j].site2);
+                }
+
+                for(auto site : sites) {
+                    if(last_non_diagonal[site] != NONE) {
+                        add_edge(last_non_diagonal[site], j);
+                    }
+                    if(!info[j].diagonal) {
+                        for(auto i : diagonals_since[site]) {
+                            add_edge(i, j);
+                        }
+                    }
+                }
+                for(auto site : sites) {
+                    if(info[j].diagonal) {
+                        diagonals_since[site].push_back(j);
+                    } else {
+                        last_non_diagonal[site] = j;
+                        diagonals_since[site].clear();
+                    }
+                }
+            }
+
+            /* Greedy list scheduling */
+            std::vector<size_t> ready;
+            for(size_t j = 0;j < num_gates;j++) {
+                if(num_predecessors[j] == 0) {
+                    ready.push_back(j);
+                }
+            }
+
+            State state{cursor, dirty};
+            std::vector<size_t> order;
+            order.reserve(num_gates);
+            while(!ready.empty()) {
+                size_t best = 0;
+                Cost best_cost{NONE, NONE};
+                for(size_t k = 0;k < ready.size();k++) {
+                    Cost c = cost(info[ready[k]], state);
+                    // ties are broken by program order
+                    if(c < best_cost || (!(best_cost < c) && ready[k] < ready[best])) {
+                        best = k;
+                        best_cost = c;
+                    }
+                }
+
+                size_t j = ready[best];
+                ready.erase(ready.begin() + best);
+                advance(info[j], state);
+                order.push_back(j);
+
+                for(auto next : successors[j]) {
+                    if(--num_predecessors[next] == 0) {
+                        ready.push_back(next);
+                    }
+                }
+            }
+
+            assert(order.size() == num_gates);
+            return order;
+        }
+
+        /** @brief compares the cost of the original and the scheduled order of `gates`. */
+        Report report(const Cursor& cursor, const std::vector<const Gate*>& gates,
+                      const std::vector<size_t>& order, bool dirty = false) const {
+            std::vector<const Gate*> scheduled;
+            scheduled.reserve(order.size());
+            for(auto j : order) {
+                scheduled.push_back(gates[j]);
+            }
+            auto before = total(State{cursor, dirty}, gates);
+            auto after = total(State{cursor, dirty}, scheduled);
+            return Report{before.shifts, after.shifts, before.decompositions, after.decompositions};
+        }
+    };
+} // namespace qcircuit
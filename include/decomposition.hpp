@@ -0,0 +1,139 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <itensor/all.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include "qcircuit_exception.hpp"
+#include "device_decomposition.hpp"
+
+namespace qcircuit {
+    using namespace itensor;
+
+    /**
+     * @brief Decomposition backends of the merged wave function, selected by `Args`.
+     *
+     * All the backends have the same interface as `itensor::svd(T, U, S, V, args)`:
+     * the indices of `U` given on input are the row indices of `T`.
+     * The backend is selected with the argument "Decomposition":
+     * - "Full" (default): `itensor::svd()`.
+     * - "Randomized": randomized SVD (Halko, Martinsson and Tropp).
+     *   The range of `T` is sampled with "MaxDim" + "Oversampling" random vectors,
+     *   refined with "PowerIterations" power iterations,
+     *   and then only the small projected matrix is decomposed.
+     *   "Cutoff" and the truncation error are relative to the norm of `T`,
+     *   so the weight outside the sampled range counts as truncated.
+     *   This is used only when "MaxDim" is set and smaller than the dimensions of `T`,
+     *   otherwise it falls back to the full SVD.
+     * - "Device": SVD on a CUDA device (see `DeviceDecomposition`), available if built with `QCIRCUIT_WITH_CUDA`.
+     *   Merged tensors smaller than "DeviceMinDim" fall back to the full SVD.
+     */
+    class Decomposition {
+    public:
+        static constexpr int DEFAULT_OVERSAMPLING = 10;
+        static constexpr int DEFAULT_POWER_ITERATIONS = 1;
+
+        /** @brief returns whether the backend "Device" is built. */
+        static constexpr bool hasDevice() {
+#ifdef QCIRCUIT_WITH_CUDA
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /** @brief returns whether `method` is a valid value of "Decomposition". */
+        static bool isValidMethod(const std::string& method) {
+            return method == "Full" || method == "Randomized" || (method == "Device" && hasDevice());
+        }
+
+        /** @brief decomposes `T` into `U`, `S` and `V` with the backend specified in `args`. */
+        static Spectrum decompose(const ITensor& T, ITensor& U, ITensor& S, ITensor& V, const Args& args) {
+            auto method = args.getString("Decomposition", "Full");
+            if(method == "Full") {
+                return svd(T, U, S, V, args);
+            }
+            if(method == "Randomized") {
+                return randomizedSvd(T, U, S, V, args);
+            }
+#ifdef QCIRCUIT_WITH_CUDA
+            if(method == "Device") {
+                return DeviceDecomposition::svd(T, U, S, V, args);
+            }
+#endif
+            throw QCircuitException("Unknown decomposition method: " + method);
+        }
+
+        /** @brief randomized SVD of `T` (see the class description). */
+        static Spectrum randomizedSvd(const ITensor& T, ITensor& U, ITensor& S, ITensor& V, const Args& args) {
+            const long max_dim = args.getInt("MaxDim", 0);
+            const long oversampling = args.getInt("Oversampling", DEFAULT_OVERSAMPLING);
+            const int power_iterations = args.getInt("PowerIterations", DEFAULT_POWER_ITERATIONS);
+
+            /* Split indices into rows (those of `U`) and columns */
+            std::vector<Index> row_inds, col_inds;
+            long row_dim = 1, col_dim = 1;
+            for(auto&& index : inds(T)) {
+                if(hasIndex(U, index)) {
+                    row_inds.push_back(index);
+                    row_dim *= dim(index);
+                } else {
+                    col_inds.push_back(index);
+                    col_dim *= dim(index);
+                }
+            }
+
+            const long sketch_dim = max_dim + oversampling;
+            if(max_dim <= 0 || sketch_dim >= std::min(row_dim, col_dim)) {
+                return svd(T, U, S, V, args); // nothing to gain from sketching
+            }
+
+            /* Gaussian test matrix. A fixed seed keeps the decomposition deterministic. */
+            auto sketch = Index(sketch_dim, "Sketch");
+            std::vector<Index> omega_inds(col_inds);
+            omega_inds.push_back(sketch);
+            std::mt19937 engine(static_cast<std::uint32_t>(row_dim*31 + col_dim));
+            std::normal_distribution<> dist(0.0, 1.0);
+            std::vector<Real> elements(col_dim*sketch_dim);
+            for(auto&& x : elements) {
+                x = dist(engine);
+            }
+            ITensor omega(IndexSet(omega_inds), Dense<Real>(std::move(elements)));
+
+            /* Orthonormal basis Q of the range of T */
+            auto Q = orthonormalBasis(T*omega, row_inds);
+            for(int k = 0;k < power_iterations;k++) {
+                Q = orthonormalBasis(T*(dag(T)*Q), row_inds);
+            }
+
+            /* Small SVD of B = Q^dagger T. The weight of T outside the range of Q is lost already,
+             * so the cutoff of B is what remains of that of T. */
+            auto B = dag(Q)*T;
+            const Real total = sqr(norm(T));
+            const Real sketched = sqr(norm(B));
+            const Real cutoff = args.getReal("Cutoff", 0.0);
+            auto b_args = args;
+            b_args.add("Cutoff", (sketched > 0.0) ? std::max(0.0, (cutoff*total - (total - sketched))/sketched) : 0.0);
+            ITensor UB(commonIndex(B, Q));
+            auto spec = svd(B, UB, S, V, b_args);
+            U = Q*UB;
+
+            const Real truncerr = (total > 0.0) ? std::max(0.0, 1.0 - sqr(norm(S))/total) : 0.0;
+            Vector eigs = spec.eigsKept();
+            return Spectrum(std::move(eigs), {"Truncerr", truncerr});
+        }
+
+    private:
+        /** @brief returns an isometry whose range is that of `Y` (as a matrix from `row_inds` to the others). */
+        static ITensor orthonormalBasis(const ITensor& Y, const std::vector<Index>& row_inds) {
+            ITensor Q(row_inds), D, W;
+            svd(Y, Q, D, W, {"Cutoff", 1e-14});
+            return Q;
+        }
+    };
+} // namespace qcircuit
@@ -0,0 +1,265 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#ifdef QCIRCUIT_WITH_CUDA
+
+#include <itensor/all.h>
+#include <cuda_runtime.h>
+#include <cusolverDn.h>
+#include <vector>
+#include <string>
+#include <complex>
+#include <algorithm>
+#include <type_traits>
+#include "qcircuit_exception.hpp"
+
+namespace qcircuit {
+    using namespace itensor;
+
+    /**
+     * @brief SVD of the merged wave function on a CUDA device with cuSOLVER (Jacobi `gesvdj`).
+     *
+     * This is the backend "Device" of `Decomposition`, built if `QCIRCUIT_WITH_CUDA` is defined
+     * (the CMake option `QCIRCUIT_USE_CUDA`).
+     * `T` is copied to the device as a matrix, decomposed, and the leading singular vectors are copied back.
+     * The tensors of the circuit stay in host memory between decompositions,
+     * since ITensor storage cannot live on a device;
+     * the device buffers are kept per thread and only grow, so repeated decompositions do not allocate.
+     *
+     * The truncation follows "Cutoff" (relative to the sum of squared singular values), "MaxDim" and "MinDim".
+     * Merged tensors smaller than "DeviceMinDim" in either dimension are decomposed by `itensor::svd()`,
+     * since the transfer dominates for them.
+     */
+    class DeviceDecomposition {
+    public:
+        static constexpr long DEFAULT_DEVICE_MIN_DIM = 256;
+
+        /** @brief decomposes `T` as `itensor::svd(T, U, S, V, args)` does. */
+        static Spectrum svd(const ITensor& T, ITensor& U, ITensor& S, ITensor& V, const Args& args) {
+            /* Split indices into rows (those of `U`) and columns */
+            std::vector<Index> row_inds, col_inds;
+            long row_dim = 1, col_dim = 1;
+            for(auto&& index : inds(T)) {
+                if(hasIndex(U, index)) {
+                    row_inds.push_back(index);
+                    row_dim *= dim(index);
+                } else {
+                    col_inds.push_back(index);
+                    col_dim *= dim(index);
+                }
+            }
+
+            if(std::min(row_dim, col_dim) < args.getInt("DeviceMinDim", DEFAULT_DEVICE_MIN_DIM)) {
+                return itensor::svd(T, U, S, V, args);
+            }
+            if(isComplex(T)) {
+                return decompose<Cplx>(T, U, S, V, args, row_inds, col_inds, row_dim, col_dim);
+            }
+            return decompose<Real>(T, U, S, V, args, row_inds, col_inds, row_dim, col_dim);
+        }
+
+    private:
+        static void check(cudaError_t status, const char* what) {
+            if(status != cudaSuccess) {
+                throw QCircuitException(std::string("CUDA error in ") + what + " : " + cudaGetErrorString(status));
+            }
+        }
+
+        static void check(cusolverStatus_t status, const char* what) {
+            if(status != CUSOLVER_STATUS_SUCCESS) {
+                throw QCircuitException(std::string("cuSOLVER error in ") + what);
+            }
+        }
+
+        /** @brief device memory which only grows. */
+        class DeviceBuffer {
+        private:
+            void* ptr = nullptr;
+            size_t capacity = 0;
+
+        public:
+            DeviceBuffer() = default;
+            DeviceBuffer(const DeviceBuffer&) = delete;
+            DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+            ~DeviceBuffer() {
+                cudaFree(ptr);
+            }
+
+            template<typename T>
+            T* reserve(size_t count) {
+                const size_t bytes = count*sizeof(T);
+                if(bytes > capacity) {
+                    check(cudaFree(ptr), "cudaFree");
+                    ptr = nullptr;
+                    capacity = 0;
+                    check(cudaMalloc(&ptr, bytes), "cudaMalloc");
+                    capacity = bytes;
+                }
+                return static_cast<T*>(ptr);
+            }
+        };
+
+        /** @brief cuSOLVER handle and buffers of the calling thread. */
+        struct Context {
+            cusolverDnHandle_t handle = nullptr;
+            gesvdjInfo_t params = nullptr;
+            DeviceBuffer a, s, u, v, work, info;
+
+            Context() {
+                check(cusolverDnCreate(&handle), "cusolverDnCreate");
+                check(cusolverDnCreateGesvdjInfo(&params), "cusolverDnCreateGesvdjInfo");
+            }
+            Context(const Context&) = delete;
+            Context& operator=(const Context&) = delete;
+            ~Context() {
+                cusolverDnDestroyGesvdjInfo(params);
+                cusolverDnDestroy(handle);
+            }
+
+            static Context& get() {
+                thread_local Context context;
+                return context;
+            }
+        };
+
+        /** @brief ITensor task copying the dense storage out. */
+        template<typename T>
+        struct CopyStorage {
+            std::vector<T>& out;
+        };
+
+        template<typename T>
+        friend void doTask(const CopyStorage<T>& task, const Dense<T>& d) {
+            task.out.assign(d.data(), d.data() + d.size());
+        }
+
+        static cusolverStatus_t bufferSize(Context& c, int m, int n, Real* a, Real* s, Real* u, Real* v, int* lwork) {
+            return cusolverDnDgesvdj_bufferSize(c.handle, CUSOLVER_EIG_MODE_VECTOR, 1, m, n, a, m, s, u, m, v, n, lwork, c.params);
+        }
+
+        static cusolverStatus_t bufferSize(Context& c, int m, int n, Cplx* a, Real* s, Cplx* u, Cplx* v, int* lwork) {
+            return cusolverDnZgesvdj_bufferSize(c.handle, CUSOLVER_EIG_MODE_VECTOR, 1, m, n,
+                                                reinterpret_cast<cuDoubleComplex*>(a), m, s,
+                                                reinterpret_cast<cuDoubleComplex*>(u), m,
+                                                reinterpret_cast<cuDoubleComplex*>(v), n, lwork, c.params);
+        }
+
+        static cusolverStatus_t gesvdj(Context& c, int m, int n, Real* a, Real* s, Real* u, Real* v,
+                                       Real* work, int lwork, int* info) {
+            return cusolverDnDgesvdj(c.handle, CUSOLVER_EIG_MODE_VECTOR, 1, m, n, a, m, s, u, m, v, n,
+                                     work, lwork, info, c.params);
+        }
+
+        static cusolverStatus_t gesvdj(Context& c, int m, int n, Cplx* a, Real* s, Cplx* u, Cplx* v,
+                                       Cplx* work, int lwork, int* info) {
+            return cusolverDnZgesvdj(c.handle, CUSOLVER_EIG_MODE_VECTOR, 1, m, n,
+                                     reinterpret_cast<cuDoubleComplex*>(a), m, s,
+                                     reinterpret_cast<cuDoubleComplex*>(u), m,
+                                     reinterpret_cast<cuDoubleComplex*>(v), n,
+                                     reinterpret_cast<cuDoubleComplex*>(work), lwork, info, c.params);
+        }
+
+        /**
+         * @brief returns the number of singular values kept and sets the truncation error,
+         * relative to the sum of the squared singular values `probabilities` in descending order.
+         */
+        static long truncate(const std::vector<Real>& probabilities, const Args& args, Real& truncerr) {
+            const long size = static_cast<long>(probabilities.size());
+            const Real cutoff = args.getReal("Cutoff", 0.0);
+            const long max_dim = std::min(size, static_cast<long>(args.getInt("MaxDim", size)));
+            const long min_dim = std::max(1L, static_cast<long>(args.getInt("MinDim", 1)));
+
+            Real total = 0.0;
+            for(auto p : probabilities) {
+                total += p;
+            }
+
+            long keep = max_dim;
+            Real discarded = 0.0;
+            for(long k = keep;k < size;k++) {
+                discarded += probabilities[k];
+            }
+            while(keep > min_dim && discarded + probabilities[keep-1] <= cutoff*total) {
+                discarded += probabilities[keep-1];
+                keep--;
+            }
+            truncerr = (total > 0.0) ? discarded/total : 0.0;
+            return keep;
+        }
+
+        template<typename E>
+        static Spectrum decompose(const ITensor& T, ITensor& U, ITensor& S, ITensor& V, const Args& args,
+                                  const std::vector<Index>& row_inds, const std::vector<Index>& col_inds,
+                                  long row_dim, long col_dim) {
+            const int m = static_cast<int>(row_dim);
+            const int n = static_cast<int>(col_dim);
+            const int rank = std::min(m, n);
+
+            /* Column-major storage with the row indices first is the matrix T(rows, cols). */
+            std::vector<Index> order(row_inds);
+            order.insert(order.end(), col_inds.begin(), col_inds.end());
+            ITensor matrix = permute(T, IndexSet(order));
+            matrix.scaleTo(1.0); // the storage is read without the scale factor of the tensor
+            std::vector<E> host_a;
+            doTask(CopyStorage<E>{host_a}, matrix.store());
+
+            auto& c = Context::get();
+            E* a = c.a.reserve<E>(host_a.size());
+            Real* s = c.s.reserve<Real>(rank);
+            E* u = c.u.reserve<E>(static_cast<size_t>(m)*rank);
+            E* v = c.v.reserve<E>(static_cast<size_t>(n)*rank);
+            int* info = c.info.reserve<int>(1);
+            check(cudaMemcpy(a, host_a.data(), host_a.size()*sizeof(E), cudaMemcpyHostToDevice), "cudaMemcpy");
+
+            int lwork = 0;
+            check(bufferSize(c, m, n, a, s, u, v, &lwork), "gesvdj_bufferSize");
+            E* work = c.work.reserve<E>(lwork);
+            check(gesvdj(c, m, n, a, s, u, v, work, lwork, info), "gesvdj");
+
+            int host_info = 0;
+            check(cudaMemcpy(&host_info, info, sizeof(int), cudaMemcpyDeviceToHost), "cudaMemcpy");
+            if(host_info != 0) {
+                throw QCircuitException("gesvdj did not converge : info = " + std::to_string(host_info));
+            }
+
+            std::vector<Real> values(rank);
+            check(cudaMemcpy(values.data(), s, rank*sizeof(Real), cudaMemcpyDeviceToHost), "cudaMemcpy");
+            std::vector<Real> probabilities(rank);
+            for(int k = 0;k < rank;k++) {
+                probabilities[k] = values[k]*values[k];
+            }
+            Real truncerr = 0.0;
+            const long keep = truncate(probabilities, args, truncerr);
+
+            /* The first `keep` columns of U (m x rank) and V (n x rank) are contiguous. */
+            std::vector<E> host_u(static_cast<size_t>(m)*keep), host_v(static_cast<size_t>(n)*keep);
+            check(cudaMemcpy(host_u.data(), u, host_u.size()*sizeof(E), cudaMemcpyDeviceToHost), "cudaMemcpy");
+            check(cudaMemcpy(host_v.data(), v, host_v.size()*sizeof(E), cudaMemcpyDeviceToHost), "cudaMemcpy");
+            if constexpr(std::is_same<E, Cplx>::value) {
+                for(auto&& x : host_v) {
+                    x = std::conj(x); // T = U S V^dagger
+                }
+            }
+
+            auto u_index = Index(keep, "Link,U");
+            auto v_index = Index(keep, "Link,V");
+            std::vector<Index> u_inds(row_inds), v_inds(col_inds);
+            u_inds.push_back(u_index);
+            v_inds.push_back(v_index);
+            U = ITensor(IndexSet(u_inds), Dense<E>(std::move(host_u)));
+            V = ITensor(IndexSet(v_inds), Dense<E>(std::move(host_v)));
+            values.resize(keep);
+            S = diagITensor(values, u_index, v_index);
+
+            Vector eigs(keep);
+            for(long k = 0;k < keep;k++) {
+                eigs(k) = probabilities[k];
+            }
+            return Spectrum(std::move(eigs), {"Truncerr", truncerr});
+        }
+    };
+} // namespace qcircuit
+
+#endif // QCIRCUIT_WITH_CUDA
@@ -0,0 +1,92 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <itensor/all.h>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include "quantum_gate.hpp"
+
+namespace qcircuit {
+    using namespace itensor;
+
+    /**
+     * @brief Cache of tensor operators of gates, keyed by `GateKey`.
+     *
+     * Deep circuits apply the same few gates on the same sites many times,
+     * so the tensor operator of a gate is built only on its first use.
+     * Since the key includes the sites, a cache must be used with a fixed set of physical indices,
+     * i.e. one cache per circuit.
+     *
+     * To keep the memory bounded for circuits with continuously varying parameters,
+     * all the entries are discarded when the number of entries exceeds `capacity`.
+     */
+    class GateCache {
+    private:
+        struct KeyHash {
+            size_t operator()(const GateKey& key) const {
+                size_t ret = std::hash<std::type_index>()(key.type);
+                auto combine = [&ret](size_t h) {
+                    ret ^= h + 0x9e3779b97f4a7c15 + (ret << 6) + (ret >> 2);
+                };
+                for(auto site : key.sites) {
+                    combine(std::hash<size_t>()(site));
+                }
+                for(auto parameter : key.parameters) {
+                    combine(std::hash<double>()(parameter));
+                }
+                return ret;
+            }
+        };
+
+        std::unordered_map<GateKey, ITensor, KeyHash> table;
+        size_t capacity;
+
+    public:
+        static const size_t DEFAULT_CAPACITY = 4096;
+
+        explicit GateCache(size_t capacity = DEFAULT_CAPACITY) : capacity(capacity) {}
+
+        /**
+         * @brief returns the tensor operator of `gate` on the physical indices `slist`.
+         *
+         * The returned reference is valid until the next call of `op()` or `clear()`.
+         */
+        const ITensor& op(const Gate& gate, const std::vector<Index>& slist) {
+            auto key = gate.key();
+            auto itr = table.find(key);
+            if(itr != table.end()) {
+                return itr->second;
+            }
+
+            if(table.size() >= capacity) {
+                table.clear();
+            }
+            return table.emplace(key, gate.op(slist)).first->second;
+        }
+
+        /** @brief discards all the entries. */
+        void clear() {
+            table.clear();
+        }
+
+        /** @brief returns number of cached operators. */
+        size_t size() const {
+            return table.size();
+        }
+
+        size_t getCapacity() const {
+            return capacity;
+        }
+
+        /** @brief sets maximum number of entries. Existing entries are discarded if exceeding it. */
+        void setCapacity(size_t capacity) {
+            this->capacity = capacity;
+            if(table.size() > capacity) {
+                table.clear();
+            }
+        }
+    };
+} // namespace qcircuit
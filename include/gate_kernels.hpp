@@ -0,0 +1,232 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <itensor/all.h>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include "qcircuit_exception.hpp"
+
+namespace qcircuit {
+    using namespace itensor;
+
+    /**
+     * @brief In-place kernels applying 1- and 2-qubit gate matrices to the physical indices of a dense tensor.
+     *
+     * A gate acting on the physical indices of `Psi` is a small matrix acting on every slice
+     * of the other indices, so the storage is updated directly instead of contracting
+     * an operator tensor with `Psi`, which involves index matching, permutation and a BLAS call.
+     * The kernels are specialized by the structure of the matrix:
+     * - `Diagonal` (e.g. `Z`, `P`, `CZ`, `CP`): one multiplication per element.
+     * - `Monomial`, one nonzero per row and column (e.g. `X`, `Y`, `CNOT`, `Swap`):
+     *   a permutation with phases, without a matrix multiplication.
+     * - `Dense`: a general matrix-vector product per slice.
+     *
+     * The innermost loop runs over contiguous elements, so that it is vectorized by the compiler.
+     * The kernels are ITensor tasks (`doTask()`), so shared storage is duplicated before being written.
+     */
+    namespace gate_kernels {
+
+        enum class Structure {
+            Diagonal,
+            Monomial,
+            Dense,
+        };
+
+        /** @brief returns the structure of a row-major `dim` x `dim` matrix. */
+        template<size_t N>
+        Structure classify(const std::array<Cplx, N>& u, size_t dim) {
+            bool diagonal = true;
+            bool monomial = true;
+            for(size_t i = 0;i < dim;i++) {
+                size_t nonzeros_in_row = 0, nonzeros_in_column = 0;
+                for(size_t j = 0;j < dim;j++) {
+                    if(u[dim*i + j] != 0.0) {
+                        nonzeros_in_row++;
+                        diagonal = diagonal && (i == j);
+                    }
+                    if(u[dim*j + i] != 0.0) {
+                        nonzeros_in_column++;
+                    }
+                }
+                monomial = monomial && nonzeros_in_row == 1 && nonzeros_in_column == 1;
+            }
+            return diagonal ? Structure::Diagonal : (monomial ? Structure::Monomial : Structure::Dense);
+        }
+
+        /** @brief returns whether all the elements are real. */
+        template<size_t N>
+        bool isRealMatrix(const std::array<Cplx, N>& u) {
+            return std::all_of(u.begin(), u.end(), [](const Cplx& x) { return x.imag() == 0.0; });
+        }
+
+        /**
+         * @brief ITensor task applying a `2^Arity` x `2^Arity` matrix to the elements of type `T`.
+         *
+         * `strides[k]` is the stride of the `k`-th physical index in the storage,
+         * and the basis `|i1 i2>` of a 2-qubit matrix is numbered as `2*i1 + i2`.
+         */
+        template<size_t Arity, Structure S, typename T>
+        struct ApplyMatrix {
+            static constexpr size_t DIM = size_t(1) << Arity;
+
+            std::array<T, DIM*DIM> u;
+            std::array<size_t, Arity> strides;
+        };
+
+        /** @brief returns `u` converted to elements of `T`. `u` must be real if `T` is real. */
+        template<typename T, size_t N>
+        std::array<T, N> convertMatrix(const std::array<Cplx, N>& u) {
+            std::array<T, N> ret;
+            for(size_t k = 0;k < N;k++) {
+                if constexpr(std::is_same<T, Real>::value) {
+                    assert(u[k].imag() == 0.0);
+                    ret[k] = u[k].real();
+                } else {
+                    ret[k] = u[k];
+                }
+            }
+            return ret;
+        }
+
+        /** @brief applies `task` to the contiguous `data` of `size` elements. */
+        template<size_t Arity, Structure S, typename T>
+        void applyMatrix(const ApplyMatrix<Arity, S, T>& task, T* data, size_t size) {
+            constexpr size_t DIM = ApplyMatrix<Arity, S, T>::DIM;
+            const auto& u = task.u;
+
+            /* Offset of each basis state |i1 i2> from the base of a slice */
+            std::array<size_t, DIM> offsets;
+            for(size_t k = 0;k < DIM;k++) {
+                offsets[k] = 0;
+                for(size_t a = 0;a < Arity;a++) {
+                    if((k >> (Arity-1-a)) & 1) {
+                        offsets[k] += task.strides[a];
+                    }
+                }
+            }
+
+            /* For monomial matrices, the only nonzero column of each row */
+            std::array<size_t, DIM> columns{};
+            std::array<T, DIM> values{};
+            if constexpr(S == Structure::Monomial) {
+                for(size_t i = 0;i < DIM;i++) {
+                    for(size_t j = 0;j < DIM;j++) {
+                        if(u[DIM*i + j] != T(0)) {
+                            columns[i] = j;
+                            values[i] = u[DIM*i + j];
+                        }
+                    }
+                }
+            }
+
+            /* Applies the matrix to slices starting at base, base+1, ..., base+count-1 */
+            auto kernel = [&](size_t base, size_t count) {
+                T* p = data + base;
+#pragma omp simd
+                for(size_t l = 0;l < count;l++) {
+                    if constexpr(S == Structure::Diagonal) {
+                        for(size_t k = 0;k < DIM;k++) {
+                            p[l + offsets[k]] *= u[(DIM+1)*k];
+                        }
+                    } else {
+                        T x[DIM];
+                        for(size_t k = 0;k < DIM;k++) {
+                            x[k] = p[l + offsets[k]];
+                        }
+                        for(size_t i = 0;i < DIM;i++) {
+                            if constexpr(S == Structure::Monomial) {
+                                p[l + offsets[i]] = values[i]*x[columns[i]];
+                            } else {
+                                T y = 0;
+                                for(size_t j = 0;j < DIM;j++) {
+                                    y += u[DIM*i + j]*x[j];
+                                }
+                                p[l + offsets[i]] = y;
+                            }
+                        }
+                    }
+                }
+            };
+
+            /* Split the storage into [lo][2]([mid][2])[rest], where lo and hi are the strides. */
+            const size_t lo = *std::min_element(task.strides.begin(), task.strides.end());
+            const size_t hi = *std::max_element(task.strides.begin(), task.strides.end());
+            const size_t blocks = size / (2*hi);
+            if constexpr(Arity == 1) {
+                for(size_t r = 0;r < blocks;r++) {
+                    kernel(r*2*hi, lo);
+                }
+            } else {
+                static_assert(Arity == 2, "only 1- and 2-qubit kernels are implemented");
+                const size_t mid = hi / (2*lo);
+                for(size_t r = 0;r < blocks;r++) {
+                    for(size_t m = 0;m < mid;m++) {
+                        kernel(r*2*hi + m*2*lo, lo);
+                    }
+                }
+            }
+        }
+
+        template<size_t Arity, Structure S, typename T>
+        void doTask(const ApplyMatrix<Arity, S, T>& task, Dense<T>& d) {
+            applyMatrix(task, d.data(), d.size());
+        }
+
+        /** @brief returns the stride of `index` in the dense storage of `T`, which is column-major. */
+        inline size_t strideOf(const ITensor& T, const Index& index) {
+            size_t stride = 1;
+            for(auto&& i : inds(T)) {
+                if(i == index) {
+                    return stride;
+                }
+                stride *= dim(i);
+            }
+            throw QCircuitException("Gate kernel : index not found");
+        }
+
+        /**
+         * @brief applies a row-major `2^Arity` x `2^Arity` matrix `u` to the physical indices `sites` of `psi` in place.
+         *
+         * `psi` must have dense storage. Real storage is kept if `u` is real.
+         */
+        template<size_t Arity, size_t N>
+        void apply(ITensor& psi, const std::array<Cplx, N>& u, const std::array<Index, Arity>& sites) {
+            static_assert(N == (size_t(1) << Arity)*(size_t(1) << Arity), "matrix size does not match the arity");
+            constexpr size_t DIM = size_t(1) << Arity;
+
+            std::array<size_t, Arity> strides;
+            for(size_t a = 0;a < Arity;a++) {
+                strides[a] = strideOf(psi, sites[a]);
+            }
+
+            std::array<Cplx, N> matrix = u;
+            const bool real_matrix = isRealMatrix(matrix);
+            if(isComplex(psi) || !real_matrix) {
+                if(!isComplex(psi)) {
+                    /* Converting the storage to complex costs a pass; the factor i is compensated in the matrix. */
+                    psi *= Cplx(0.0, 1.0);
+                    for(auto&& x : matrix) {
+                        x *= Cplx(0.0, -1.0);
+                    }
+                }
+                auto v = convertMatrix<Cplx>(matrix);
+                switch(classify(matrix, DIM)) {
+                case Structure::Diagonal: doTask(ApplyMatrix<Arity, Structure::Diagonal, Cplx>{v, strides}, psi.store()); break;
+                case Structure::Monomial: doTask(ApplyMatrix<Arity, Structure::Monomial, Cplx>{v, strides}, psi.store()); break;
+                case Structure::Dense: doTask(ApplyMatrix<Arity, Structure::Dense, Cplx>{v, strides}, psi.store()); break;
+                }
+            } else {
+                auto v = convertMatrix<Real>(matrix);
+                switch(classify(matrix, DIM)) {
+                case Structure::Diagonal: doTask(ApplyMatrix<Arity, Structure::Diagonal, Real>{v, strides}, psi.store()); break;
+                case Structure::Monomial: doTask(ApplyMatrix<Arity, Structure::Monomial, Real>{v, strides}, psi.store()); break;
+                case Structure::Dense: doTask(ApplyMatrix<Arity, Structure::Dense, Real>{v, strides}, psi.store()); break;
+                }
+            }
+        }
+    } // namespace gate_kernels
+} // namespace qcircuit
@@ -0,0 +1,89 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include "quantum_gate.hpp"
+#include "qcircuit_exception.hpp"
+
+namespace qcircuit {
+
+    /**
+     * @brief Gate types which can be encoded in `GateSpec`.
+     */
+    enum class GateOpcode : std::int32_t {
+        Id = 0,
+        X,
+        Y,
+        Z,
+        H,
+        P,                 //!< @brief uses `theta`
+        UniversalUnitary,  //!< @brief uses `theta`, `phi` and `lambda`
+        Proj_0,
+        Proj_1,
+        Proj_0_to_1,
+        Proj_1_to_0,
+        CNOT,
+        CY,
+        CZ,
+        CP,                //!< @brief uses `theta`
+        CUniversalUnitary, //!< @brief uses `theta`, `phi` and `lambda`
+        Swap,
+    };
+
+    /**
+     * @brief Plain-old-data encoding of a gate.
+     *
+     * Whole circuits can be passed as a contiguous array of this struct
+     * (e.g. a NumPy structured array) instead of one gate object per call.
+     * `site2` is ignored for one-site gates, and unused parameters are ignored.
+     */
+    struct GateSpec {
+        std::int32_t opcode;   //!< @brief `GateOpcode` value.
+        std::uint32_t site1;   //!< @brief Site of one-site gates, or first site of two-site gates.
+        std::uint32_t site2;   //!< @brief Second site of two-site gates.
+        double theta;
+        double phi;
+        double lambda;
+    };
+
+    /**
+     * @brief constructs the gate encoded in `spec` on the stack and calls `f` with it.
+     *
+     * `f` is called with a concrete gate type, e.g. `const CNOT&`,
+     * so overloads for `OneSiteGate` and `TwoSiteGate` are resolved statically.
+     */
+    template<typename Function>
+    void visitGate(const GateSpec& spec, Function&& f) {
+        const size_t site1 = spec.site1;
+        const size_t site2 = spec.site2;
+
+        switch(static_cast<GateOpcode>(spec.opcode)) {
+        case GateOpcode::Id: f(Id(site1)); break;
+        case GateOpcode::X: f(X(site1)); break;
+        case GateOpcode::Y: f(Y(site1)); break;
+        case GateOpcode::Z: f(Z(site1)); break;
+        case GateOpcode::H: f(H(site1)); break;
+        case GateOpcode::P: f(P(site1, spec.theta)); break;
+        case GateOpcode::UniversalUnitary:
+            f(UniversalUnitary(site1, spec.theta, spec.phi, spec.lambda)); break;
+        case GateOpcode::Proj_0: f(Proj_0(site1)); break;
+        case GateOpcode::Proj_1: f(Proj_1(site1)); break;
+        case GateOpcode::Proj_0_to_1: f(Proj_0_to_1(site1)); break;
+        case GateOpcode::Proj_1_to_0: f(Proj_1_to_0(site1)); break;
+        case GateOpcode::CNOT: f(CNOT(site1, site2)); break;
+        case GateOpcode::CY: f(CY(site1, site2)); break;
+        case GateOpcode::CZ: f(CZ(site1, site2)); break;
+        case GateOpcode::CP: f(CP(site1, site2, spec.theta)); break;
+        case GateOpcode::CUniversalUnitary:
+            f(CUniversalUnitary(site1, site2, spec.theta, spec.phi, spec.lambda)); break;
+        case GateOpcode::Swap: f(Swap(site1, site2)); break;
+        default:
+            std::stringstream ss;
+            ss << "Unknown gate opcode " << spec.opcode;
+            throw QCircuitException(ss.str());
+        }
+    }
+} // namespace qcircuit
@@ -0,0 +1,173 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <mpi.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <limits>
+#include <cstdint>
+#include "parameter_sweep.hpp"
+#include "qcircuit_exception.hpp"
+
+namespace qcircuit {
+
+    /**
+     * @brief Distributes the points of a `ParameterSweep` over the ranks of an MPI communicator.
+     *
+     * All the ranks construct the same sweep and call `run()` collectively.
+     * The prefix of rank 0 is broadcast as a checkpoint, so that only rank 0 has to simulate
+     * (or load) the common prefix of the circuits.
+     * Then rank 0 hands out points one by one to the other ranks as they finish the previous ones,
+     * i.e. dynamic load balancing, and gathers the results.
+     * With a single rank, the points are evaluated by `ParameterSweep::run()`.
+     *
+     * MPI must be initialized by the caller. Each rank other than 0 evaluates one point at a time.
+     */
+    class MpiSweepDriver {
+    private:
+        static constexpr int TAG_WORK = 1;
+        static constexpr int TAG_RESULT = 2;
+        static constexpr std::uint64_t STOP = std::numeric_limits<std::uint64_t>::max();
+
+        MPI_Comm comm;
+
+        static void check(int status, const char* what) {
+            if(status != MPI_SUCCESS) {
+                throw QCircuitException(std::string("MPI error in ") + what);
+            }
+        }
+
+        static int messageSize(size_t size) {
+            if(size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+                throw QCircuitException("MPI message exceeds 2GB");
+            }
+            return static_cast<int>(size);
+        }
+
+        void sendPoint(std::uint64_t point, int rank) const {
+            check(MPI_Send(&point, 1, MPI_UINT64_T, rank, TAG_WORK, comm), "MPI_Send");
+        }
+
+        SweepResult receiveResult(int& source) const {
+            MPI_Status status;
+            check(MPI_Probe(MPI_ANY_SOURCE, TAG_RESULT, comm, &status), "MPI_Probe");
+            int size = 0;
+            check(MPI_Get_count(&status, MPI_BYTE, &size), "MPI_Get_count");
+            std::string buffer(size, '\0');
+            check(MPI_Recv(&buffer[0], size, MPI_BYTE, status.MPI_SOURCE, TAG_RESULT, comm, MPI_STATUS_IGNORE), "MPI_Recv");
+            source = status.MPI_SOURCE;
+
+            std::stringstream ss(buffer);
+            return SweepResult::read(ss);
+        }
+
+        /** @brief Loop of rank 0, which returns all the results in order of point. */
+        std::vector<SweepResult> coordinate(const ParameterSweep& sweep, int num_ranks) const {
+            std::vector<SweepResult> ret(sweep.size());
+            std::uint64_t next = 0;
+            int active = 0;
+
+            for(int rank = 1;rank < num_ranks;rank++) {
+                if(next < sweep.size()) {
+                    sendPoint(next++, rank);
+                    active++;
+                } else {
+                    sendPoint(STOP, rank);
+                }
+            }
+
+            while(active > 0) {
+                int source;
+                auto result = receiveResult(source);
+                ret[result.point] = std::move(result);
+                if(next < sweep.size()) {
+                    sendPoint(next++, source);
+                } else {
+                    sendPoint(STOP, source);
+                    active--;
+                }
+            }
+
+            for(auto&& result : ret) {
+                if(!result.error.empty()) {
+                    std::stringstream ss;
+                    ss << "Point " << result.point << " failed : " << result.error;
+                    throw QCircuitException(ss.str());
+                }
+            }
+            return ret;
+        }
+
+        /** @brief Loop of the other ranks. */
+        void work(const ParameterSweep& sweep) const {
+            while(true) {
+                std::uint64_t point;
+                check(MPI_Recv(&point, 1, MPI_UINT64_T, 0, TAG_WORK, comm, MPI_STATUS_IGNORE), "MPI_Recv");
+                if(point == STOP) {
+                    return;
+                }
+
+                std::stringstream ss;
+                sweep.evaluateNoThrow(point).write(ss);
+                auto buffer = ss.str();
+                check(MPI_Send(&buffer[0], messageSize(buffer.size()), MPI_BYTE, 0, TAG_RESULT, comm), "MPI_Send");
+            }
+        }
+
+    public:
+        explicit MpiSweepDriver(MPI_Comm comm = MPI_COMM_WORLD) : comm(comm) {}
+
+        int rank() const {
+            int ret;
+            check(MPI_Comm_rank(comm, &ret), "MPI_Comm_rank");
+            return ret;
+        }
+
+        int numberOfRanks() const {
+            int ret;
+            check(MPI_Comm_size(comm, &ret), "MPI_Comm_size");
+            return ret;
+        }
+
+        /** @brief broadcasts `data` of rank 0, e.g. a checkpoint, to all the ranks. */
+        void broadcast(std::string& data) const {
+            std::uint64_t size = data.size();
+            check(MPI_Bcast(&size, 1, MPI_UINT64_T, 0, comm), "MPI_Bcast");
+            data.resize(size);
+            check(MPI_Bcast(&data[0], messageSize(size), MPI_BYTE, 0, comm), "MPI_Bcast");
+        }
+
+        /**
+         * @brief evaluates all the points of `sweep` over the ranks.
+         *
+         * If `broadcast_prefix` is true, the prefix of `sweep` on the other ranks is replaced by that of rank 0.
+         * It may be false if all the ranks already have the same prefix.
+         * Rank 0 returns the results in order of point, and the other ranks return an empty vector.
+         * Failures of points are rethrown on rank 0 after all the points are done.
+         */
+        std::vector<SweepResult> run(ParameterSweep& sweep, bool broadcast_prefix = true) const {
+            const int num_ranks = numberOfRanks();
+            const int my_rank = rank();
+
+            if(broadcast_prefix) {
+                std::string checkpoint = (my_rank == 0) ? sweep.getCheckpoint() : std::string();
+                broadcast(checkpoint);
+                if(my_rank != 0) {
+                    sweep.setCheckpoint(checkpoint);
+                }
+            }
+
+            if(num_ranks == 1) {
+                return sweep.run();
+            }
+            if(my_rank == 0) {
+                return coordinate(sweep, num_ranks);
+            }
+            work(sweep);
+            return {};
+        }
+    };
+} // namespace qcircuit
@@ -0,0 +1,253 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <sstream>
+#include <cstdint>
+#include "qcircuit.hpp"
+#include "qasm_program.hpp"
+#include "binary_io.hpp"
+#include "qcircuit_exception.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace qcircuit {
+
+    /** @brief Result of one point of a `ParameterSweep`. */
+    struct SweepResult {
+        size_t point = 0;                  //!< @brief Index of the point in the grid.
+        std::vector<double> expectations;  //!< @brief <Z> of each logical qubit.
+        std::vector<int> bits;             //!< @brief Classical bits returned by the body, e.g. `QasmProgram::run()`.
+        /** @brief `shots` samples of the logical qubits, `samples[shot*size() + i]` for the qubit `i` in the shot `shot`. */
+        std::vector<std::uint8_t> samples;
+        std::string error;                 //!< @brief Message of the exception thrown by the evaluation, if any.
+
+        void write(std::ostream& os) const {
+            binary_io::writeSize(os, point);
+            binary_io::writeSize(os, expectations.size());
+            for(auto value : expectations) {
+                binary_io::writeValue<double>(os, value);
+            }
+            binary_io::writeSize(os, bits.size());
+            for(auto bit : bits) {
+                binary_io::writeValue<std::int32_t>(os, bit);
+            }
+            binary_io::writeString(os, std::string(samples.begin(), samples.end()));
+            binary_io::writeString(os, error);
+        }
+
+        static SweepResult read(std::istream& is) {
+            SweepResult ret;
+            ret.point = binary_io::readSize(is);
+            ret.expectations.resize(binary_io::readSize(is));
+            for(auto&& value : ret.expectations) {
+                value = binary_io::readValue<double>(is);
+            }
+            ret.bits.resize(binary_io::readSize(is));
+            for(auto&& bit : ret.bits) {
+                bit = binary_io::readValue<std::int32_t>(is);
+            }
+            auto samples = binary_io::readString(is);
+            ret.samples.assign(samples.begin(), samples.end());
+            ret.error = binary_io::readString(is);
+            return ret;
+        }
+    };
+
+    /**
+     * @brief Evaluation of a circuit template over a grid of parameters.
+     *
+     * Each point forks the prefix circuit (see `QCircuit::fork()`), applies the body
+     * with the parameter values of the point, and records <Z> of each logical qubit
+     * and optionally samples of the final state.
+     * The fork of the point `i` is seeded with `seed + i`, so results do not depend on
+     * how points are distributed, locally by `run()` or over MPI ranks by `MpiSweepDriver`.
+     *
+     * The prefix is kept as a checkpoint (see `QCircuit::save()`),
+     * which is the form in which it is sent to other processes.
+     */
+    class ParameterSweep {
+    public:
+        /** @brief applies the template with `values` to `circuit` and returns classical bits, if any. */
+        using Body = std::function<std::vector<int>(QCircuit& circuit, const std::vector<double>& values)>;
+
+    private:
+        std::shared_ptr<const QCircuit> prefix;
+        std::string checkpoint; //!< @brief `prefix` written by `QCircuit::save()`.
+        Body body;
+        std::vector<std::vector<double>> points;
+        size_t shots = 0;
+        std::uint32_t seed = 0;
+        int num_threads = 0; //!< @brief Number of threads of `run()`. 0 means the OpenMP default.
+
+    public:
+        ParameterSweep(const QCircuit& prefix, Body body, const std::vector<std::vector<double>>& points) :
+            body(std::move(body)), points(points) {
+            setPrefix(prefix);
+        }
+
+        /**
+         * @brief returns a sweep of `program`, whose free parameters `parameter_names` take
+         * the values of each point in this order.
+         */
+        static ParameterSweep fromProgram(const QCircuit& prefix, const QasmProgram& program,
+                                          const std::vector<std::string>& parameter_names,
+                                          const std::vector<std::vector<double>>& points) {
+            auto shared_program = std::make_shared<const QasmProgram>(program);
+            Body body = [shared_program, parameter_names](QCircuit& circuit, const std::vector<double>& values) {
+                std::map<std::string, double> bindings;
+                for(size_t k = 0;k < parameter_names.size();k++) {
+                    bindings[parameter_names[k]] = values.at(k);
+                }
+                return shared_program->run(circuit, bindings);
+            };
+            return ParameterSweep(prefix, body, points);
+        }
+
+        /** @brief sets the state from which every point starts. */
+        ParameterSweep& setPrefix(const QCircuit& prefix) {
+            std::stringstream ss;
+            prefix.save(ss);
+            checkpoint = ss.str();
+            this->prefix = std::make_shared<const QCircuit>(prefix.fork());
+            return *this;
+        }
+
+        /** @brief sets the prefix from a checkpoint written by `QCircuit::save()`. */
+        ParameterSweep& setCheckpoint(const std::string& checkpoint) {
+            std::stringstream ss(checkpoint);
+            prefix = std::make_shared<const QCircuit>(QCircuit::load(ss));
+            this->checkpoint = checkpoint;
+            return *this;
+        }
+
+        const std::string& getCheckpoint() const {
+            return checkpoint;
+        }
+
+        const QCircuit& getPrefix() const {
+            return *prefix;
+        }
+
+        size_t size() const {
+            return points.size();
+        }
+
+        const std::vector<std::vector<double>>& getPoints() const {
+            return points;
+        }
+
+        /** @brief sets the number of samples of each point. 0 means no sampling. */
+        ParameterSweep& setShots(size_t shots) {
+            this->shots = shots;
+            return *this;
+        }
+
+        size_t getShots() const {
+            return shots;
+        }
+
+        ParameterSweep& setSeed(std::uint32_t seed) {
+            this->seed = seed;
+            return *this;
+        }
+
+        std::uint32_t getSeed() const {
+            return seed;
+        }
+
+        /** @brief sets number of threads of `run()`. 0 means the OpenMP default. */
+        ParameterSweep& setNumThreads(int num_threads) {
+            this->num_threads = num_threads;
+            return *this;
+        }
+
+        int getNumThreads() const {
+            return num_threads;
+        }
+
+        /**
+         * @brief evaluates the point `point`.
+         *
+         * Exceptions are not caught; see `run()` for batches.
+         */
+        SweepResult evaluate(size_t point) const {
+            auto circuit = prefix->fork(seed + static_cast<std::uint32_t>(point));
+            SweepResult ret;
+            ret.point = point;
+            ret.bits = body(circuit, points.at(point));
+
+            const size_t size = circuit.size();
+            auto probabilities = circuit.marginalProbabilities();
+            ret.expectations.resize(size);
+            for(size_t qubit = 0;qubit < size;qubit++) {
+                ret.expectations[qubit] = 2.0*probabilities[circuit.siteOf(qubit)] - 1.0;
+            }
+
+            if(shots > 0) {
+                auto samples = circuit.sample(shots);
+                ret.samples.resize(samples.size());
+                for(size_t shot = 0;shot < shots;shot++) {
+                    for(size_t qubit = 0;qubit < size;qubit++) {
+                        ret.samples[shot*size + qubit] = samples[shot*size + circuit.siteOf(qubit)];
+                    }
+                }
+            }
+            return ret;
+        }
+
+        /**
+         * @brief evaluates the point `point`, storing the message of an exception in `SweepResult::error`.
+         */
+        SweepResult evaluateNoThrow(size_t point) const {
+            try {
+                return evaluate(point);
+            } catch(const std::exception& e) {
+                SweepResult ret;
+                ret.point = point;
+                ret.error = e.what();
+                return ret;
+            }
+        }
+
+        /**
+         * @brief evaluates all the points in this process, in parallel with dynamic scheduling.
+         *
+         * If some points throw, the remaining points are still evaluated
+         * and the first exception (in order of point) is rethrown.
+         */
+        std::vector<SweepResult> run() const {
+            const long count = static_cast<long>(points.size());
+            std::vector<SweepResult> ret(count);
+            std::vector<std::exception_ptr> errors(count);
+
+#ifdef _OPENMP
+            const int threads = (num_threads > 0) ? num_threads : omp_get_max_threads();
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+#endif
+            for(long i = 0;i < count;i++) {
+                try {
+                    ret[i] = evaluate(static_cast<size_t>(i));
+                } catch(...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+
+            for(auto&& error : errors) {
+                if(error) {
+                    std::rethrow_exception(error);
+                }
+            }
+            return ret;
+        }
+    };
+} // namespace qcircuit
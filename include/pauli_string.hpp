@@ -0,0 +1,100 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <itensor/all.h>
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include "quantum_gate.hpp"
+#include "qcircuit_exception.hpp"
+
+namespace qcircuit {
+    using namespace itensor;
+
+    /**
+     * @brief Product of Pauli operators on distinct sites with a coefficient, e.g. 0.5 * X0 Z3.
+     *
+     * Only the non-identity factors are stored, sorted by site.
+     * A Hamiltonian is a vector of terms (see `QCircuit::expectation()`).
+     */
+    class PauliString {
+    public:
+        using Factor = std::pair<size_t, char>; //!< @brief Site and Pauli operator ('X', 'Y' or 'Z').
+
+    private:
+        std::vector<Factor> factors;
+        Cplx coefficient;
+
+        static bool isPauli(char pauli) {
+            return pauli == 'I' || pauli == 'X' || pauli == 'Y' || pauli == 'Z';
+        }
+
+    public:
+        /**
+         * @brief constructs from the Pauli operators on the sites `factors`.
+         *
+         * Identity factors ('I') are dropped. Sites must be distinct.
+         */
+        PauliString(const std::vector<Factor>& factors, Cplx coefficient = 1.0) : coefficient(coefficient) {
+            for(auto&& factor : factors) {
+                if(!isPauli(factor.second)) {
+                    throw QCircuitException(std::string("Invalid Pauli operator : ") + factor.second);
+                }
+                if(factor.second != 'I') {
+                    this->factors.push_back(factor);
+                }
+            }
+            std::sort(this->factors.begin(), this->factors.end());
+            for(size_t k = 1;k < this->factors.size();k++) {
+                if(this->factors[k-1].first == this->factors[k].first) {
+                    throw QCircuitException("Invalid Pauli string : Duplicate site " + std::to_string(this->factors[k].first));
+                }
+            }
+        }
+
+        /** @brief constructs from a dense string, e.g. "XIIZ", whose k-th character acts on the site k. */
+        PauliString(const std::string& paulis, Cplx coefficient = 1.0) :
+            PauliString(denseFactors(paulis), coefficient) {}
+
+        const std::vector<Factor>& getFactors() const {
+            return factors;
+        }
+
+        Cplx getCoefficient() const {
+            return coefficient;
+        }
+
+        /** @brief returns the number of non-identity factors. */
+        size_t weight() const {
+            return factors.size();
+        }
+
+        /** @brief returns the largest site plus one, or 0 for the identity. */
+        size_t extent() const {
+            return factors.empty() ? 0 : factors.back().first + 1;
+        }
+
+        /** @brief returns the tensor operator of the Pauli operator `pauli` on `site`. */
+        static ITensor op(char pauli, size_t site, const std::vector<Index>& s) {
+            switch(pauli) {
+            case 'X': return X(site).op(s);
+            case 'Y': return Y(site).op(s);
+            case 'Z': return Z(site).op(s);
+            case 'I': return Id(site).op(s);
+            }
+            throw QCircuitException(std::string("Invalid Pauli operator : ") + pauli);
+        }
+
+    private:
+        static std::vector<Factor> denseFactors(const std::string& paulis) {
+            std::vector<Factor> ret;
+            for(size_t site = 0;site < paulis.size();site++) {
+                ret.emplace_back(site, paulis[site]);
+            }
+            return ret;
+        }
+    };
+} // namespace qcircuit
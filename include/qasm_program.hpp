@@ -0,0 +1,1010 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <array>
+#include <cmath>
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include "circuit_topology.hpp"
+#include "qcircuit.hpp"
+#include "gate_spec.hpp"
+#include "qcircuit_exception.hpp"
+
+namespace qcircuit {
+
+    /**
+     * @brief OpenQASM 2.0 program lowered to a flat list of instructions on a topology.
+     *
+     * `parse()` expands all the gate definitions (including "qelib1.inc") into `U`, `CX` and `swap`,
+     * and maps quantum registers to the logical qubits of `QCircuit` in order of declaration.
+     * Then `run()` applies the instructions to a circuit through `QCircuit::applyAllLogical()`,
+     * so a program is parsed once and run many times.
+     * Routing is left to the circuit: `swap` only relabels qubits,
+     * and a `CX` on distant qubits moves the target next to the control.
+     *
+     * As an extension, identifiers in top-level parameter expressions which are not defined
+     * (e.g. `theta` in `rz(theta) q[0];`) are free parameters of the program,
+     * whose values are given on each `run()`.
+     *
+     * `U` is lowered to `UniversalUnitary`, which equals the OpenQASM `U` up to a global phase.
+     * `opaque` gates cannot be called.
+     */
+    class QasmProgram {
+    public:
+        static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+        /** @brief Classical register, whose bits are `[offset, offset+size)` of the classical bits. */
+        struct Register {
+            std::string name;
+            size_t offset;
+            size_t size;
+        };
+
+        /** @brief Lowered operation. */
+        struct Instruction {
+            enum class Kind { Gate, Measure, Reset };
+
+            Kind kind;
+            GateOpcode opcode;                  //!< @brief `UniversalUnitary`, `CNOT` or `Swap` for `Kind::Gate`.
+            size_t qubit1;                      //!< @brief Logical qubit.
+            size_t qubit2;                      //!< @brief Second logical qubit of two-site gates.
+            std::array<size_t, 3> parameters;   //!< @brief Expressions of `theta`, `phi` and `lambda` of `U`.
+            size_t bit;                         //!< @brief Classical bit of `Kind::Measure`.
+            size_t condition_register;          //!< @brief Register of `if` statement, or `NONE`.
+            std::uint64_t condition_value;
+        };
+
+    private:
+        /** @brief Node of parameter expressions. Constant subexpressions are folded on construction. */
+        struct Expression {
+            enum class Kind { Constant, Parameter, Argument, Negate, Add, Subtract, Multiply, Divide, Power,
+                              Sin, Cos, Tan, Exp, Ln, Sqrt };
+
+            Kind kind;
+            double value;  //!< @brief Value of `Kind::Constant`.
+            size_t index;  //!< @brief Free parameter of `Kind::Parameter`, or formal argument of `Kind::Argument`.
+            size_t lhs;
+            size_t rhs;
+        };
+
+        /** @brief Gate call in a gate definition, with qubits as formal argument indices. */
+        struct GateCall {
+            std::string name;
+            std::vector<size_t> parameters;
+            std::vector<size_t> qubits;
+            size_t line;
+        };
+
+        struct GateDefinition {
+            size_t num_parameters;
+            size_t num_qubits;
+            std::vector<GateCall> body;
+            bool opaque;
+            bool swap = false; //!< @brief Whether this is `swap` of "qelib1.inc", which is lowered to `Swap`.
+        };
+
+        struct QuantumRegister {
+            size_t offset; //!< @brief First virtual qubit.
+            size_t size;
+        };
+
+        size_t num_sites = 0;
+        std::vector<Instruction> instructions;
+        std::vector<Expression> expressions = {Expression{Expression::Kind::Constant, 0.0, 0, NONE, NONE}}; //!< @brief The first one is the constant 0.
+        std::vector<std::string> parameter_names;
+        std::vector<Register> classical_registers;
+        size_t num_classical_bits = 0;
+        size_t num_qubits = 0;
+
+    public:
+        /** @brief Standard header "qelib1.inc" of OpenQASM 2.0, which is used for `include "qelib1.inc";`. */
+        static const std::string& qelib1() {
+            static const std::string source = R"(
+gate u3(theta,phi,lambda) q { U(theta,phi,lambda) q; }
+gate u2(phi,lambda) q { U(pi/2,phi,lambda) q; }
+gate u1(lambda) q { U(0,0,lambda) q; }
+gate cx c,t { CX c,t; }
+gate id a { U(0,0,0) a; }
+gate u0(gamma) q { U(0,0,0) q; }
+gate x a { u3(pi,0,pi) a; }
+gate y a { u3(pi,pi/2,pi/2) a; }
+gate z a { u1(pi) a; }
+gate h a { u2(0,pi) a; }
+gate s a { u1(pi/2) a; }
+gate sdg a { u1(-pi/2) a; }
+gate t a { u1(pi/4) a; }
+gate tdg a { u1(-pi/4) a; }
+gate rx(theta) a { u3(theta,-pi/2,pi/2) a; }
+gate ry(theta) a { u3(theta,0,0) a; }
+gate rz(phi) a { u1(phi) a; }
+gate cz a,b { h b; cx a,b; h b; }
+gate cy a,b { sdg b; cx a,b; s b; }
+gate swap a,b { cx a,b; cx b,a; cx a,b; }
+gate ch a,b { h b; sdg b; cx a,b; h b; t b; cx a,b; t b; h b; s b; x b; s a; }
+gate ccx a,b,c { h c; cx b,c; tdg c; cx a,c; t c; cx b,c; tdg c; cx a,c; t b; t c; h c; cx a,b; t a; tdg b; cx a,b; }
+gate cswap a,b,c { cx c,b; ccx a,b,c; cx c,b; }
+gate crz(lambda) a,b { u1(lambda/2) b; cx a,b; u1(-lambda/2) b; cx a,b; }
+gate cu1(lambda) a,b { u1(lambda/2) a; cx a,b; u1(lambda/2) b; cx a,b; u1(-lambda/2) b; }
+gate cu3(theta,phi,lambda) c,t { u1((lambda+phi)/2) c; u1((lambda-phi)/2) t; cx c,t; u3(-theta/2,0,-(phi+lambda)/2) t; cx c,t; u3(theta/2,phi,0) t; }
+gate rzz(theta) a,b { cx a,b; u1(theta) b; cx a,b; }
+)";
+            return source;
+        }
+
+        /**
+         * @brief parses OpenQASM 2.0 `source` for circuits on `topology`.
+         *
+         * Files other than "qelib1.inc" in `include` statements are read from the file system.
+         * Throws `QCircuitException` with the line number on errors.
+         */
+        static QasmProgram parse(const std::string& source, const CircuitTopology& topology) {
+            QasmProgram program;
+            program.num_sites = topology.numberOfBits();
+            Parser parser(program);
+            parser.parseProgram(source);
+            return program;
+        }
+
+        /**
+         * @brief applies the program to `circuit` and returns the classical bits.
+         *
+         * `bindings` gives the values of the free parameters (see `getParameters()`).
+         * Gates between measurements are applied by one `QCircuit::applyAllLogical()` call,
+         * and the layout of `circuit` is updated by the routing.
+         */
+        std::vector<int> run(QCircuit& circuit, const std::map<std::string, double>& bindings = {}) const {
+            if(circuit.size() != num_sites) {
+                throw QCircuitException("QASM program is lowered for a different number of qubits");
+            }
+
+            std::vector<double> values(parameter_names.size());
+            for(size_t k = 0;k < parameter_names.size();k++) {
+                auto found = bindings.find(parameter_names[k]);
+                if(found == bindings.end()) {
+                    throw QCircuitException("Parameter " + parameter_names[k] + " is not bound");
+                }
+                values[k] = found->second;
+            }
+
+            std::vector<int> bits(num_classical_bits, 0);
+            std::vector<GateSpec> pending;
+            auto flush = [&circuit, &pending]() {
+                if(!pending.empty()) {
+                    circuit.applyAllLogical(pending);
+                    pending.clear();
+                }
+            };
+
+            /* Consecutive unconditional measurements are done at once by `QCircuit::measure()`. */
+            std::vector<size_t> measured_sites, measured_bits;
+            auto flush_measurements = [&circuit, &bits, &measured_sites, &measured_bits]() {
+                if(!measured_sites.empty()) {
+                    auto outcomes = circuit.measure(measured_sites);
+                    for(size_t k = 0;k < outcomes.size();k++) {
+                        bits[measured_bits[k]] = outcomes[k];
+                    }
+                    measured_sites.clear();
+                    measured_bits.clear();
+                }
+            };
+
+            for(auto&& instruction : instructions) {
+                if(instruction.kind == Instruction::Kind::Measure && instruction.condition_register == NONE) {
+                    flush(); // the layout has to be up to date for siteOf()
+                    auto site = circuit.siteOf(instruction.qubit1);
+                    if(std::find(measured_sites.begin(), measured_sites.end(), site) != measured_sites.end()) {
+                        flush_measurements();
+                    }
+                    measured_sites.push_back(site);
+                    measured_bits.push_back(instruction.bit);
+                    continue;
+                }
+                flush_measurements();
+
+                if(instruction.condition_register != NONE
+                   && registerValue(bits, classical_registers[instruction.condition_register]) != instruction.condition_value) {
+                    continue;
+                }
+
+                switch(instruction.kind) {
+                case Instruction::Kind::Gate:
+                    pending.push_back(GateSpec{static_cast<std::int32_t>(instruction.opcode),
+                                               static_cast<std::uint32_t>(instruction.qubit1),
+                                               static_cast<std::uint32_t>(instruction.qubit2),
+                                               evaluate(instruction.parameters[0], values),
+                                               evaluate(instruction.parameters[1], values),
+                                               evaluate(instruction.parameters[2], values)});
+                    break;
+                case Instruction::Kind::Measure:
+                    flush();
+                    bits[instruction.bit] = circuit.measure({circuit.siteOf(instruction.qubit1)})[0];
+                    break;
+                case Instruction::Kind::Reset:
+                    flush();
+                    circuit.resetQubit(circuit.siteOf(instruction.qubit1));
+                    break;
+                }
+            }
+            flush();
+            flush_measurements();
+
+            return bits;
+        }
+
+        const std::vector<Instruction>& getInstructions() const {
+            return instructions;
+        }
+
+        /** @brief returns the names of the free parameters in order of appearance. */
+        const std::vector<std::string>& getParameters() const {
+            return parameter_names;
+        }
+
+        const std::vector<Register>& getClassicalRegisters() const {
+            return classical_registers;
+        }
+
+        size_t numberOfClassicalBits() const {
+            return num_classical_bits;
+        }
+
+        /** @brief returns the number of declared qubits. */
+        size_t numberOfQubits() const {
+            return num_qubits;
+        }
+
+        /** @brief returns the value of the classical register `name` in `bits` returned by `run()`. */
+        std::uint64_t registerValue(const std::vector<int>& bits, const std::string& name) const {
+            for(auto&& reg : classical_registers) {
+                if(reg.name == name) {
+                    return registerValue(bits, reg);
+                }
+            }
+            throw QCircuitException("Classical register " + name + " not found");
+        }
+
+    private:
+        /** @brief returns the value of `reg`, where the bit `i` of the register has the weight 2^i. */
+        static std::uint64_t registerValue(const std::vector<int>& bits, const Register& reg) {
+            std::uint64_t ret = 0;
+            for(size_t i = 0;i < reg.size;i++) {
+                ret |= static_cast<std::uint64_t>(bits[reg.offset + i] != 0) << i;
+            }
+            return ret;
+        }
+
+        double evaluate(size_t node, const std::vector<double>& values) const {
+            const Expression& e = expressions[node];
+            switch(e.kind) {
+            case Expression::Kind::Constant: return e.value;
+            case Expression::Kind::Parameter: return values[e.index];
+            case Expression::Kind::Argument: break; // never remains after expansion
+            case Expression::Kind::Negate: return -evaluate(e.lhs, values);
+            case Expression::Kind::Add: return evaluate(e.lhs, values) + evaluate(e.rhs, values);
+            case Expression::Kind::Subtract: return evaluate(e.lhs, values) - evaluate(e.rhs, values);
+            case Expression::Kind::Multiply: return evaluate(e.lhs, values) * evaluate(e.rhs, values);
+            case Expression::Kind::Divide: return evaluate(e.lhs, values) / evaluate(e.rhs, values);
+            case Expression::Kind::Power: return std::pow(evaluate(e.lhs, values), evaluate(e.rhs, values));
+            case Expression::Kind::Sin: return std::sin(evaluate(e.lhs, values));
+            case Expression::Kind::Cos: return std::cos(evaluate(e.lhs, values));
+            case Expression::Kind::Tan: return std::tan(evaluate(e.lhs, values));
+            case Expression::Kind::Exp: return std::exp(evaluate(e.lhs, values));
+            case Expression::Kind::Ln: return std::log(evaluate(e.lhs, values));
+            case Expression::Kind::Sqrt: return std::sqrt(evaluate(e.lhs, values));
+            }
+            throw QCircuitException("Invalid QASM expression");
+        }
+
+        /** @brief adds an expression node, folding it if all the operands are constants. */
+        size_t makeExpression(Expression::Kind kind, size_t lhs, size_t rhs = NONE) {
+            Expression e{kind, 0.0, 0, lhs, rhs};
+            bool constant = expressions[lhs].kind == Expression::Kind::Constant
+                            && (rhs == NONE || expressions[rhs].kind == Expression::Kind::Constant);
+            expressions.push_back(e);
+            if(constant) {
+                double value = evaluate(expressions.size()-1, {});
+                expressions.back() = Expression{Expression::Kind::Constant, value, 0, NONE, NONE};
+            }
+            return expressions.size()-1;
+        }
+
+        size_t makeConstant(double value) {
+            expressions.push_back(Expression{Expression::Kind::Constant, value, 0, NONE, NONE});
+            return expressions.size()-1;
+        }
+
+        /** @brief returns `node` with formal arguments replaced by `arguments`. */
+        size_t substitute(size_t node, const std::vector<size_t>& arguments) {
+            const Expression e = expressions[node];
+            switch(e.kind) {
+            case Expression::Kind::Constant:
+            case Expression::Kind::Parameter:
+                return node;
+            case Expression::Kind::Argument:
+                return arguments[e.index];
+            default:
+                size_t lhs = substitute(e.lhs, arguments);
+                size_t rhs = (e.rhs == NONE) ? NONE : substitute(e.rhs, arguments);
+                return makeExpression(e.kind, lhs, rhs);
+            }
+        }
+
+        /** @brief Recursive-descent parser, which lowers statements into `program` as they are parsed. */
+        class Parser {
+        private:
+            /** @brief Token of OpenQASM. Symbols include "->" and "==". */
+            struct Token {
+                enum class Kind { Identifier, Real, Integer, String, Symbol, End };
+
+                Kind kind;
+                std::string text;
+                size_t line;
+            };
+
+            QasmProgram& program;
+
+            std::vector<Token> tokens;
+            size_t position = 0;
+
+            std::map<std::string, GateDefinition> definitions;
+            std::map<std::string, QuantumRegister> quantum_registers;
+            std::map<std::string, size_t> classical_register_ids;
+            std::map<std::string, size_t> parameter_ids;
+
+            bool parsing_qelib1 = false;
+
+            /** @brief Formal arguments while parsing a gate definition. */
+            const std::vector<std::string>* formal_parameters = nullptr;
+
+        public:
+            explicit Parser(QasmProgram& program) : program(program) {}
+
+            void parseProgram(const std::string& source) {
+                tokens = tokenize(source);
+                position = 0;
+
+                expectKeyword("OPENQASM");
+                auto version = next();
+                if(version.kind != Token::Kind::Real && version.kind != Token::Kind::Integer) {
+                    error(version, "version number expected");
+                }
+                if(version.text != "2.0" && version.text != "2") {
+                    error(version, "only OpenQASM 2.0 is supported");
+                }
+                expectSymbol(";");
+
+                parseStatements();
+            }
+
+        private:
+            [[noreturn]] static void error(const Token& token, const std::string& message) {
+                std::stringstream ss;
+                ss << "QASM error at line " << token.line << " : " << message;
+                if(token.kind != Token::Kind::End) {
+                    ss << " (near \"" << token.text << "\")";
+                }
+                throw QCircuitException(ss.str());
+            }
+
+            static std::vector<Token> tokenize(const std::string& source) {
+                std::vector<Token> ret;
+                size_t line = 1;
+                size_t i = 0;
+                const size_t n = source.size();
+
+                while(i < n) {
+                    char c = source[i];
+                    if(c == '\n') {
+                        line++;
+                        i++;
+                    } else if(std::isspace(static_cast<unsigned char>(c))) {
+                        i++;
+                    } else if(c == '/' && i+1 < n && source[i+1] == '/') {
+                        while(i < n && source[i] != '\n') {
+                            i++;
+                        }
+                    } else if(std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                        size_t start = i;
+                        while(i < n && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_')) {
+                            i++;
+                        }
+                        ret.push_back(Token{Token::Kind::Identifier, source.substr(start, i-start), line});
+                    } else if(std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && i+1 < n && std::isdigit(static_cast<unsigned char>(source[i+1])))) {
+                        size_t start = i;
+                        bool real = false;
+                        while(i < n && std::isdigit(static_cast<unsigned char>(source[i]))) {
+                            i++;
+                        }
+                        if(i < n && source[i] == '.') {
+                            real = true;
+                            i++;
+                            while(i < n && std::isdigit(static_cast<unsigned char>(source[i]))) {
+                                i++;
+                            }
+                        }
+                        if(i < n && (source[i] == 'e' || source[i] == 'E')) {
+                            real = true;
+                            i++;
+                            if(i < n && (source[i] == '+' || source[i] == '-')) {
+                                i++;
+                            }
+                            while(i < n && std::isdigit(static_cast<unsigned char>(source[i]))) {
+                                i++;
+                            }
+                        }
+                        ret.push_back(Token{real ? Token::Kind::Real : Token::Kind::Integer, source.substr(start, i-start), line});
+                    } else if(c == '"') {
+                        size_t start = ++i;
+                        while(i < n && source[i] != '"' && source[i] != '\n') {
+                            i++;
+                        }
+                        if(i >= n || source[i] != '"') {
+                            error(Token{Token::Kind::End, "", line}, "unterminated string");
+                        }
+                        ret.push_back(Token{Token::Kind::String, source.substr(start, i-start), line});
+                        i++;
+                    } else if((c == '-' && i+1 < n && source[i+1] == '>') || (c == '=' && i+1 < n && source[i+1] == '=')) {
+                        ret.push_back(Token{Token::Kind::Symbol, source.substr(i, 2), line});
+                        i += 2;
+                    } else if(std::string(";,()[]{}+-*/^").find(c) != std::string::npos) {
+                        ret.push_back(Token{Token::Kind::Symbol, std::string(1, c), line});
+                        i++;
+                    } else {
+                        error(Token{Token::Kind::Symbol, std::string(1, c), line}, "unexpected character");
+                    }
+                }
+                ret.push_back(Token{Token::Kind::End, "", line});
+                return ret;
+            }
+
+            const Token& peek() const {
+                return tokens[position];
+            }
+
+            const Token& next() {
+                const Token& ret = tokens[position];
+                if(ret.kind != Token::Kind::End) {
+                    position++;
+                }
+                return ret;
+            }
+
+            bool peekSymbol(const std::string& symbol) const {
+                return peek().kind == Token::Kind::Symbol && peek().text == symbol;
+            }
+
+            void expectSymbol(const std::string& symbol) {
+                const Token& token = next();
+                if(token.kind != Token::Kind::Symbol || token.text != symbol) {
+                    error(token, "\"" + symbol + "\" expected");
+                }
+            }
+
+            void expectKeyword(const std::string& keyword) {
+                const Token& token = next();
+                if(token.kind != Token::Kind::Identifier || token.text != keyword) {
+                    error(token, keyword + " expected");
+                }
+            }
+
+            const Token& expectIdentifier() {
+                const Token& token = next();
+                if(token.kind != Token::Kind::Identifier) {
+                    error(token, "identifier expected");
+                }
+                return token;
+            }
+
+            size_t expectInteger() {
+                const Token& token = next();
+                if(token.kind != Token::Kind::Integer) {
+                    error(token, "integer expected");
+                }
+                return std::stoull(token.text);
+            }
+
+            /** @brief parses statements until the end of the tokens. */
+            void parseStatements() {
+                while(peek().kind != Token::Kind::End) {
+                    parseStatement();
+                }
+            }
+
+            void parseStatement() {
+                const Token& token = peek();
+                if(token.kind != Token::Kind::Identifier) {
+                    error(token, "statement expected");
+                }
+
+                if(token.text == "include") {
+                    next();
+                    const Token& file = next();
+                    if(file.kind != Token::Kind::String) {
+                        error(file, "file name expected");
+                    }
+                    expectSymbol(";");
+                    include(file);
+                } else if(token.text == "qreg") {
+                    next();
+                    const Token& name = expectIdentifier();
+                    expectSymbol("[");
+                    size_t size = expectInteger();
+                    expectSymbol("]");
+                    expectSymbol(";");
+                    addQuantumRegister(name, size);
+                } else if(token.text == "creg") {
+                    next();
+                    const Token& name = expectIdentifier();
+                    expectSymbol("[");
+                    size_t size = expectInteger();
+                    expectSymbol("]");
+                    expectSymbol(";");
+                    addClassicalRegister(name, size);
+                } else if(token.text == "gate" || token.text == "opaque") {
+                    parseGateDefinition();
+                } else if(token.text == "if") {
+                    next();
+                    expectSymbol("(");
+                    const Token& name = expectIdentifier();
+                    expectSymbol("==");
+                    std::uint64_t value = expectInteger();
+                    expectSymbol(")");
+                    auto found = classical_register_ids.find(name.text);
+                    if(found == classical_register_ids.end()) {
+                        error(name, "classical register " + name.text + " not found");
+                    }
+                    parseOperation(found->second, value);
+                } else {
+                    parseOperation(NONE, 0);
+                }
+            }
+
+            void include(const Token& file) {
+                std::string source;
+                if(file.text == "qelib1.inc") {
+                    source = qelib1();
+                    parsing_qelib1 = true;
+                } else {
+                    std::ifstream ifs(file.text);
+                    if(!ifs) {
+                        error(file, "cannot open " + file.text);
+                    }
+                    std::stringstream ss;
+                    ss << ifs.rdbuf();
+                    source = ss.str();
+                }
+
+                /* Parse the file in place of the statement */
+                auto saved_tokens = std::move(tokens);
+                auto saved_position = position;
+                tokens = tokenize(source);
+                position = 0;
+                parseStatements();
+                parsing_qelib1 = false;
+                tokens = std::move(saved_tokens);
+                position = saved_position;
+            }
+
+            void addQuantumRegister(const Token& name, size_t size) {
+                if(quantum_registers.count(name.text)) {
+                    error(name, "multiple definition of quantum register " + name.text);
+                }
+                if(program.num_qubits + size > program.num_sites) {
+                    error(name, "number of quantum registers exceeds total number of qubits");
+                }
+                quantum_registers[name.text] = QuantumRegister{program.num_qubits, size};
+                program.num_qubits += size;
+            }
+
+            void addClassicalRegister(const Token& name, size_t size) {
+                if(classical_register_ids.count(name.text)) {
+                    error(name, "multiple definition of classical register " + name.text);
+                }
+                if(size > 64) {
+                    error(name, "classical registers larger than 64 bits are not supported");
+                }
+                classical_register_ids[name.text] = program.classical_registers.size();
+                program.classical_registers.push_back(Register{name.text, program.num_classical_bits, size});
+                program.num_classical_bits += size;
+            }
+
+            /** @brief parses a comma-separated list of identifiers. */
+            std::vector<std::string> parseIdentifierList() {
+                std::vector<std::string> ret;
+                ret.push_back(expectIdentifier().text);
+                while(peekSymbol(",")) {
+                    next();
+                    ret.push_back(expectIdentifier().text);
+                }
+                return ret;
+            }
+
+            void parseGateDefinition() {
+                const bool opaque = (next().text == "opaque");
+                const Token& name = expectIdentifier();
+                if(definitions.count(name.text) || name.text == "U" || name.text == "CX") {
+                    error(name, "multiple definition of gate " + name.text);
+                }
+
+                std::vector<std::string> parameters;
+                if(peekSymbol("(")) {
+                    next();
+                    if(!peekSymbol(")")) {
+                        parameters = parseIdentifierList();
+                    }
+                    expectSymbol(")");
+                }
+                std::vector<std::string> qubits = parseIdentifierList();
+
+                GateDefinition definition{parameters.size(), qubits.size(), {}, opaque};
+                if(opaque) {
+                    expectSymbol(";");
+                    definitions[name.text] = definition;
+                    return;
+                }
+
+                formal_parameters = &parameters;
+                expectSymbol("{");
+                while(!peekSymbol("}")) {
+                    const Token& callee = expectIdentifier();
+                    if(callee.text == "barrier") {
+                        parseIdentifierList();
+                        expectSymbol(";");
+                        continue;
+                    }
+
+                    GateCall call{callee.text, {}, {}, callee.line};
+                    if(peekSymbol("(")) {
+                        call.parameters = parseExpressionList();
+                    }
+                    for(auto&& qubit : parseIdentifierList()) {
+                        auto found = std::find(qubits.begin(), qubits.end(), qubit);
+                        if(found == qubits.end()) {
+                            error(callee, "unknown qubit argument " + qubit);
+                        }
+                        call.qubits.push_back(found - qubits.begin());
+                    }
+                    expectSymbol(";");
+                    checkCall(callee, call.parameters.size(), call.qubits.size());
+                    definition.body.push_back(call);
+                }
+                expectSymbol("}");
+                formal_parameters = nullptr;
+
+                definition.swap = parsing_qelib1 && name.text == "swap";
+                definitions[name.text] = definition;
+            }
+
+            /** @brief checks that the gate `callee` exists and takes the given numbers of arguments. */
+            void checkCall(const Token& callee, size_t num_parameters, size_t num_qubits) const {
+                size_t expected_parameters, expected_qubits;
+                if(callee.text == "U") {
+                    expected_parameters = 3;
+                    expected_qubits = 1;
+                } else if(callee.text == "CX") {
+                    expected_parameters = 0;
+                    expected_qubits = 2;
+                } else {
+                    auto found = definitions.find(callee.text);
+                    if(found == definitions.end()) {
+                        error(callee, "gate " + callee.text + " not defined");
+                    }
+                    if(found->second.opaque) {
+                        error(callee, "opaque gate " + callee.text + " cannot be applied");
+                    }
+                    expected_parameters = found->second.num_parameters;
+                    expected_qubits = found->second.num_qubits;
+                }
+
+                if(num_parameters != expected_parameters) {
+                    error(callee, "wrong number of parameters of " + callee.text);
+                }
+                if(num_qubits != expected_qubits) {
+                    error(callee, "wrong number of qubits of " + callee.text);
+                }
+            }
+
+            /** @brief parses an argument, i.e. a register or an element of a register. */
+            std::pair<std::string, size_t> parseArgument(const Token*& name) {
+                name = &expectIdentifier();
+                size_t index = NONE;
+                if(peekSymbol("[")) {
+                    next();
+                    index = expectInteger();
+                    expectSymbol("]");
+                }
+                return std::make_pair(name->text, index);
+            }
+
+            /** @brief returns the virtual qubits of a quantum argument. */
+            std::vector<size_t> quantumArgument(const Token& name, size_t index) const {
+                auto found = quantum_registers.find(name.text);
+                if(found == quantum_registers.end()) {
+                    error(name, "quantum register " + name.text + " not found");
+                }
+                const QuantumRegister& reg = found->second;
+                if(index != NONE) {
+                    if(index >= reg.size) {
+                        error(name, "index exceeds register size");
+                    }
+                    return {reg.offset + index};
+                }
+                std::vector<size_t> ret;
+                for(size_t i = 0;i < reg.size;i++) {
+                    ret.push_back(reg.offset + i);
+                }
+                return ret;
+            }
+
+            /** @brief returns the classical bits of a classical argument. */
+            std::vector<size_t> classicalArgument(const Token& name, size_t index) const {
+                auto found = classical_register_ids.find(name.text);
+                if(found == classical_register_ids.end()) {
+                    error(name, "classical register " + name.text + " not found");
+                }
+                const Register& reg = program.classical_registers[found->second];
+                if(index != NONE) {
+                    if(index >= reg.size) {
+                        error(name, "index exceeds register size");
+                    }
+                    return {reg.offset + index};
+                }
+                std::vector<size_t> ret;
+                for(size_t i = 0;i < reg.size;i++) {
+                    ret.push_back(reg.offset + i);
+                }
+                return ret;
+            }
+
+            /** @brief parses a quantum operation (gate call, measure, reset or barrier) with an optional condition. */
+            void parseOperation(size_t condition_register, std::uint64_t condition_value) {
+                const Token& op = expectIdentifier();
+
+                if(op.text == "barrier") {
+                    const Token* name;
+                    parseArgument(name);
+                    while(peekSymbol(",")) {
+                        next();
+                        parseArgument(name);
+                    }
+                    expectSymbol(";");
+                    return;
+                }
+
+                if(op.text == "measure" || op.text == "reset") {
+                    const Token* qname;
+                    auto qarg = parseArgument(qname);
+                    auto qubits = quantumArgument(*qname, qarg.second);
+
+                    if(op.text == "reset") {
+                        expectSymbol(";");
+                        for(auto qubit : qubits) {
+                            emit(Instruction::Kind::Reset, GateOpcode::Id, qubit, 0, {}, NONE,
+                                 condition_register, condition_value);
+                        }
+                        return;
+                    }
+
+                    expectSymbol("->");
+                    const Token* cname;
+                    auto carg = parseArgument(cname);
+                    auto bits = classicalArgument(*cname, carg.second);
+                    expectSymbol(";");
+                    if(qubits.size() != bits.size()) {
+                        error(op, "unmatching register size (" + qname->text + " and " + cname->text + ")");
+                    }
+                    for(size_t k = 0;k < qubits.size();k++) {
+                        emit(Instruction::Kind::Measure, GateOpcode::Id, qubits[k], 0, {}, bits[k],
+                             condition_register, condition_value);
+                    }
+                    return;
+                }
+
+                /* Gate call */
+                std::vector<size_t> parameters;
+                if(peekSymbol("(")) {
+                    parameters = parseExpressionList();
+                }
+                std::vector<std::vector<size_t>> arguments;
+                do {
+                    if(!arguments.empty()) {
+                        next(); // ","
+                    }
+                    const Token* name;
+                    auto arg = parseArgument(name);
+                    arguments.push_back(quantumArgument(*name, arg.second));
+                } while(peekSymbol(","));
+                expectSymbol(";");
+                checkCall(op, parameters.size(), arguments.size());
+
+                /* Broadcast over whole registers */
+                size_t count = 1;
+                for(auto&& arg : arguments) {
+                    if(arg.size() > 1) {
+                        if(count > 1 && count != arg.size()) {
+                            error(op, "unmatching register size");
+                        }
+                        count = arg.size();
+                    }
+                }
+                for(size_t k = 0;k < count;k++) {
+                    std::vector<size_t> qubits;
+                    for(auto&& arg : arguments) {
+                        qubits.push_back(arg.size() > 1 ? arg[k] : arg[0]);
+                    }
+                    for(size_t i = 0;i < qubits.size();i++) {
+                        for(size_t j = i+1;j < qubits.size();j++) {
+                            if(qubits[i] == qubits[j]) {
+                                error(op, "duplicate qubit arguments");
+                            }
+                        }
+                    }
+                    expand(op.text, parameters, qubits, op, condition_register, condition_value);
+                }
+            }
+
+            /** @brief lowers a gate call on virtual qubits into instructions. */
+            void expand(const std::string& name, const std::vector<size_t>& parameters, const std::vector<size_t>& qubits,
+                        const Token& origin, size_t condition_register, std::uint64_t condition_value) {
+                if(name == "U") {
+                    emit(Instruction::Kind::Gate, GateOpcode::UniversalUnitary, qubits[0], 0,
+                         {parameters[0], parameters[1], parameters[2]}, NONE, condition_register, condition_value);
+                    return;
+                }
+
+                if(name == "CX") {
+                    emit(Instruction::Kind::Gate, GateOpcode::CNOT, qubits[0], qubits[1],
+                         {}, NONE, condition_register, condition_value);
+                    return;
+                }
+
+                const GateDefinition& definition = definitions.at(name);
+                if(definition.swap) {
+                    emit(Instruction::Kind::Gate, GateOpcode::Swap, qubits[0], qubits[1],
+                         {}, NONE, condition_register, condition_value);
+                    return;
+                }
+                for(auto&& call : definition.body) {
+                    std::vector<size_t> actual_parameters;
+                    for(auto node : call.parameters) {
+                        actual_parameters.push_back(program.substitute(node, parameters));
+                    }
+                    std::vector<size_t> actual_qubits;
+                    for(auto index : call.qubits) {
+                        actual_qubits.push_back(qubits[index]);
+                    }
+                    expand(call.name, actual_parameters, actual_qubits, origin, condition_register, condition_value);
+                }
+            }
+
+            void emit(Instruction::Kind kind, GateOpcode opcode, size_t qubit1, size_t qubit2,
+                      std::array<size_t, 3> parameters, size_t bit,
+                      size_t condition_register, std::uint64_t condition_value) {
+                if(kind != Instruction::Kind::Gate || opcode != GateOpcode::UniversalUnitary) {
+                    parameters = {0, 0, 0}; // constant 0
+                }
+                program.instructions.push_back(Instruction{kind, opcode, qubit1, qubit2, parameters, bit,
+                                                           condition_register, condition_value});
+            }
+
+            /** @brief parses "(expr, expr, ...)". */
+            std::vector<size_t> parseExpressionList() {
+                std::vector<size_t> ret;
+                expectSymbol("(");
+                if(!peekSymbol(")")) {
+                    ret.push_back(parseExpression());
+                    while(peekSymbol(",")) {
+                        next();
+                        ret.push_back(parseExpression());
+                    }
+                }
+                expectSymbol(")");
+                return ret;
+            }
+
+            /* expression := term (("+" | "-") term)*
+             * term       := unary (("*" | "/") unary)*
+             * unary      := "-" unary | power
+             * power      := primary ("^" unary)?
+             */
+            size_t parseExpression() {
+                size_t lhs = parseTerm();
+                while(peekSymbol("+") || peekSymbol("-")) {
+                    auto kind = (next().text == "+") ? Expression::Kind::Add : Expression::Kind::Subtract;
+                    lhs = program.makeExpression(kind, lhs, parseTerm());
+                }
+                return lhs;
+            }
+
+            size_t parseTerm() {
+                size_t lhs = parseUnary();
+                while(peekSymbol("*") || peekSymbol("/")) {
+                    auto kind = (next().text == "*") ? Expression::Kind::Multiply : Expression::Kind::Divide;
+                    lhs = program.makeExpression(kind, lhs, parseUnary());
+                }
+                return lhs;
+            }
+
+            size_t parseUnary() {
+                if(peekSymbol("-")) {
+                    next();
+                    return program.makeExpression(Expression::Kind::Negate, parseUnary());
+                }
+                if(peekSymbol("+")) {
+                    next();
+                    return parseUnary();
+                }
+                size_t base = parsePrimary();
+                if(peekSymbol("^")) {
+                    next();
+                    return program.makeExpression(Expression::Kind::Power, base, parseUnary());
+                }
+                return base;
+            }
+
+            size_t parsePrimary() {
+                const Token& token = next();
+                if(token.kind == Token::Kind::Real || token.kind == Token::Kind::Integer) {
+                    return program.makeConstant(std::stod(token.text));
+                }
+                if(token.kind == Token::Kind::Symbol && token.text == "(") {
+                    size_t ret = parseExpression();
+                    expectSymbol(")");
+                    return ret;
+                }
+                if(token.kind != Token::Kind::Identifier) {
+                    error(token, "expression expected");
+                }
+
+                static const std::map<std::string, Expression::Kind> functions = {
+                    {"sin", Expression::Kind::Sin}, {"cos", Expression::Kind::Cos}, {"tan", Expression::Kind::Tan},
+                    {"exp", Expression::Kind::Exp}, {"ln", Expression::Kind::Ln}, {"sqrt", Expression::Kind::Sqrt},
+                };
+                auto function = functions.find(token.text);
+                if(function != functions.end()) {
+                    expectSymbol("(");
+                    size_t argument = parseExpression();
+                    expectSymbol(")");
+                    return program.makeExpression(function->second, argument);
+                }
+
+                if(token.text == "pi") {
+                    return program.makeConstant(M_PI);
+                }
+
+                if(formal_parameters != nullptr) {
+                    auto found = std::find(formal_parameters->begin(), formal_parameters->end(), token.text);
+                    if(found == formal_parameters->end()) {
+                        error(token, "unknown parameter " + token.text);
+                    }
+                    program.expressions.push_back(Expression{Expression::Kind::Argument, 0.0,
+                                                             static_cast<size_t>(found - formal_parameters->begin()), NONE, NONE});
+                    return program.expressions.size()-1;
+                }
+
+                /* Free parameter of the program */
+                auto found = parameter_ids.find(token.text);
+                size_t index;
+                if(found == parameter_ids.end()) {
+                    index = program.parameter_names.size();
+                    parameter_ids[token.text] = index;
+                    program.parameter_names.push_back(token.text);
+                } else {
+                    index = found->second;
+                }
+                program.expressions.push_back(Expression{Expression::Kind::Parameter, 0.0, index, NONE, NONE});
+                return program.expressions.size()-1;
+            }
+        };
+    };
+} // namespace qcircuit
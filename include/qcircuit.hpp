@@ -10,85 +10,133 @@
 #include <functional>
 #include <iostream>
 #include <array>
+#include <random>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <typeindex>
+#include <numeric>
 #include "circuit_topology.hpp"
+#include "contraction_plan.hpp"
 #include "quantum_gate.hpp"
 #include "qcircuit_exception.hpp"
+#include "sweep_environment.hpp"
+#include "pauli_string.hpp"
+#include "gate_cache.hpp"
+#include "cursor_scheduler.hpp"
+#include "gate_spec.hpp"
+#include "decomposition.hpp"
+#include "binary_io.hpp"
+#include "circuit_stats.hpp"
+#include "gate_kernels.hpp"
+#include "tensor_workspace.hpp"
 
 namespace qcircuit {
     using namespace itensor;
 
     class QCircuit;
-    Cplx overlap(QCircuit circuit1, const std::vector<ITensor>& op, QCircuit circuit2,
+    Cplx overlap(const QCircuit& circuit1, const std::vector<ITensor>& op, const QCircuit& circuit2,
                  const Args& args = Args::global());
 
     /**
      * @brief Class to store and modify wave function.
+     *
+     * Thread safety: a `QCircuit` object must not be used from more than one thread at a time,
+     * but distinct objects may be used concurrently, one circuit per thread (see `CircuitPool`).
+     * Each object owns its gate cache, random engine and the `ITensor` handles of its tensors.
+     * Copies (see `fork()`) and circuits on the same topology share read-only data:
+     * - The finalized topology and its contraction plan, which are never modified after construction
+     *   (the plan is built once under `std::call_once`, see `CircuitTopology::getContractionPlan()`).
+     * - The storage of the site tensors and of the initial state (see `reset()`).
+     *   ITensor storage is copy-on-write: a modification detaches the storage of the modified tensor,
+     *   and the shared one is only read, so forks can run concurrently.
+     * The other shared states touched by this class are
+     * - `Args::global()`, which is the default `args` of `overlap()`.
+     *   It is only read, so it must not be modified while circuits are running.
+     * - The generator of `Index` IDs in ITensor, called on every decomposition.
+     *   ITensor v3 uses a thread-local generator for it.
+     *
+     * Note that a multithreaded BLAS/LAPACK should be limited to one thread
+     * (e.g. `OMP_NUM_THREADS` for the BLAS library) when running circuits in parallel.
      */
     class QCircuit {
     private:
         std::vector<Index> s;     //!< @brief Physical (on-site) indices.
         std::vector<ITensor> M;   //!< @brief Tensor entities.
-        std::vector<ITensor> SV;  //!< @brief Singular value entities.
+        std::vector<ITensor> SV;  //!< @brief Singular value entities, stored as diagonal (`diagITensor`) real tensors.
+        SingularValueWorkspace workspace; //!< @brief Elements of `SV` and their inverses, to scale tensors in place.
         ITensor Psi;  //!< @brief TPS wave function
+        ITensor pending_op; //!< @brief Fused operator at cursor position not yet applied to `Psi` (see `setGateFusion()`).
+        bool gate_fusion = false; //!< @brief Whether operators at cursor position are fused before being applied.
+        bool use_gate_kernels = true; //!< @brief Whether gates at cursor position are applied to `Psi` in place (see `setGateKernels()`).
+        bool psi_dirty = false; //!< @brief Whether `Psi` has been modified since it was merged from `M` and `SV`.
 
-        const CircuitTopology topology; //!< @brief Circuit topology.
+        std::shared_ptr<const CircuitTopology> shared_topology; //!< @brief Finalized circuit topology, shared among copies and replicas.
+        const CircuitTopology& topology; //!< @brief Alias of `*shared_topology`.
+        std::shared_ptr<const ContractionPlan> contraction_plan; //!< @brief Contraction order of `overlap()`, shared among the circuits on the topology.
 
         std::pair<std::size_t, std::size_t> cursor; //!< @brief Position of cursor, which must be laid across two neighboring sites.
 
+        std::vector<size_t> layout;   //!< @brief Site of each logical qubit (see `applyLogical()`).
+        std::vector<size_t> qubit_at; //!< @brief Logical qubit at each site, the inverse of `layout`.
+
+        /** @brief State restored by `reset()`. */
+        struct InitialState {
+            std::vector<ITensor> M;
+            std::vector<ITensor> SV;
+            ITensor Psi;
+            std::pair<std::size_t, std::size_t> cursor;
+            bool psi_dirty;
+        };
+        std::shared_ptr<const InitialState> initial_state; //!< @brief Shared among copies until `markInitialState()`.
+
         std::mt19937 random_engine;
 
         Args default_args = Args(); //!< @brief Default arguments for ITensor functions.
 
-    public:
-        /** @brief Constructor to initialize TPS wave function.
-         *
-         * Cursor position will be set at (0, 1).
-         *
-         * @param topology Circuit Topology.
-         * @param init_qubits Initial qubit states for each site.
-         * @param physical_indices Physical (on-site) indices.
-         * If not specified, the indices will be initialized with new IDs.
-         * This argument is mainly used to share physical indices among
-         * some "replica" wave functions in the same circuit.
-         **/
-        QCircuit(const CircuitTopology& topology,
-                 const std::vector<std::pair<std::complex<double>, std::complex<double>>>& init_qubits,
-                 const std::vector<Index>& physical_indices = std::vector<Index>()) :
-            s(physical_indices), topology(topology), random_engine(std::random_device()()) {
+        GateCache gate_cache; //!< @brief Tensor operators of already applied gates.
 
-            if(!topology.isConnectedGraph()) {
-                throw QCircuitException("Invalid circuit topology : Some nodes are unreachable");
-            }
+        double last_truncation_error = 0.0; //!< @brief Truncation error of the latest `decomposePsi()`.
+        std::vector<double> truncation_errors; //!< @brief Truncation error of the latest decomposition of each link.
+
+        CircuitStats stats; //!< @brief Counters recorded if `QCIRCUIT_STATS` is defined.
 
+        size_t memory_budget = 0;       //!< @brief Budget in bytes for `M` and `SV`. 0 means unbounded.
+        std::vector<size_t> site_bytes; //!< @brief Size of each `M` in bytes.
+        std::vector<size_t> link_bytes; //!< @brief Size of each `SV` in bytes.
+
+        /**
+         * @brief sets the product state `init_qubits` with new link indices of dimension 1,
+         * and puts the cursor at (0, the smallest neighbor of 0).
+         *
+         * The physical indices, the qubit layout, the settings and the truncation errors are kept.
+         */
+        void initializeProductState(const std::vector<std::pair<std::complex<double>, std::complex<double>>>& init_qubits) {
             /* Initialize link indices */
             std::vector<std::pair<Index, Index>> a;
             a.reserve(topology.numberOfLinks());
+            SV.clear();
             SV.reserve(topology.numberOfLinks());
             for(size_t i = 0; i < topology.numberOfLinks();i++) {
                 auto index1 = Index(1, "LinkInd");
                 auto index2 = Index(1, "LinkInd");
                 a.emplace_back(index1, index2);
-                SV.emplace_back(index1, index2);
-                SV.back().set(index1=1, index2=1, 1.0);
+                SV.push_back(diagITensor(std::vector<Real>{1.0}, index1, index2));
+                workspace.update(i, SV[i]);
             }
 
-            /* Initialize physical indices */
-            if(s.empty()) {
-                s.reserve(this->size());
-                for(size_t i = 0;i < this->size();i++) {
-                    s.emplace_back(2, "SiteInd");
-                }
-            }
+            std::fill(link_bytes.begin(), link_bytes.end(), sizeof(Real));
 
             /* Initialize tensor entities */
+            M.clear();
             M.reserve(this->size());
             for(size_t i = 0;i < this->size();i++) {
                 auto neighbors = topology.neighborsOf(i);
 
                 std::vector<Index> ind_list;
                 ind_list.reserve(neighbors.size()+1);
-                std::vector<IndexVal> ind_val_list;
-                ind_val_list.reserve(neighbors.size()+1);
 
                 //fill ind_list
                 ind_list.push_back(s[i]);
@@ -100,22 +148,15 @@ namespace qcircuit {
                     }
                 }
 
-                //fill ind_val_list
-                ind_val_list.push_back(s[i](1));
-                for(const auto& neighbor : neighbors){
-                    if(i < neighbor.site) {
-                        ind_val_list.push_back((a[neighbor.link].first)(1));
-                    } else {
-                        ind_val_list.push_back((a[neighbor.link].second)(1));
-                    }
-                }
-
                 //insert into M
-                M.emplace_back(ind_list);
-                ind_val_list[0] = s[i](1);
-                M[i].set(ind_val_list, init_qubits[i].first);
-                ind_val_list[0] = s[i](2);
-                M[i].set(ind_val_list, init_qubits[i].second);
+                //All the link indices have dimension 1, so the elements are those of the qubit state.
+                const auto& qubit = init_qubits[i];
+                if(qubit.first.imag() == 0.0 && qubit.second.imag() == 0.0) {
+                    M.emplace_back(IndexSet(ind_list), Dense<Real>(std::vector<Real>{qubit.first.real(), qubit.second.real()}));
+                } else {
+                    M.emplace_back(IndexSet(ind_list), Dense<Cplx>(std::vector<Cplx>{qubit.first, qubit.second}));
+                }
+                site_bytes[i] = siteTensorBytes(M[i]);
             }
 
             /* set cursor position */
@@ -130,45 +171,192 @@ namespace qcircuit {
             }
             cursor.second = cursor_second_index;
 
+            pending_op = ITensor();
             updatePsi();
         }
 
-        /** @brief Constructor to initialize TPS wave function with |000 ... 000>.
+        /** @brief returns bond dimension of `SV[link]`. */
+        long bondDimension(size_t link) const {
+            return dim(inds(SV[link])[0]);
+        }
+
+        /** @brief returns the size of the site tensor `T` in bytes, assuming complex elements. */
+        static size_t siteTensorBytes(const ITensor& T) {
+            return static_cast<size_t>(dim(inds(T)))*sizeof(Cplx);
+        }
+
+        /**
+         * @brief returns the largest bond dimension of the cursor link
+         * which keeps `M` and `SV` within `memory_budget` after decomposing `Psi`.
+         *
+         * The other tensors are counted with their current sizes,
+         * and the new cursor tensors with the outer bond dimensions of the cursor sites.
+         * The result is at least 1.
+         */
+        long budgetedMaxDim() const {
+            auto link_index = topology.getLinkIdBetween(cursor.first, cursor.second);
+            size_t others = memoryUsage() - site_bytes[cursor.first] - site_bytes[cursor.second] - link_bytes[link_index];
+            if(others >= memory_budget) {
+                return 1;
+            }
+
+            // Outer dimensions of the new U and V
+            auto outer_dim = [this, &link_index](size_t site) {
+                size_t ret = dim(s[site]);
+                for(auto&& neighbor : topology.neighborsOf(site)) {
+                    if(neighbor.link != link_index) {
+                        ret *= bondDimension(neighbor.link);
+                    }
+                }
+                return ret;
+            };
+            size_t bytes_per_dim = (outer_dim(cursor.first) + outer_dim(cursor.second))*sizeof(Cplx) + sizeof(Real);
+
+            return std::max<long>(1, static_cast<long>((memory_budget - others)/bytes_per_dim));
+        }
+
+        /** @brief returns `topology` itself if finalized, otherwise its finalized copy. */
+        static std::shared_ptr<const CircuitTopology> finalizedTopology(std::shared_ptr<const CircuitTopology> topology) {
+            if(!topology) {
+                throw QCircuitException("Invalid circuit topology : null");
+            }
+            if(topology->isFinalized()) {
+                return topology;
+            }
+            return std::make_shared<const CircuitTopology>(topology->finalizedCopy());
+        }
+
+    public:
+        /** @brief Constructor to initialize TPS wave function.
          *
          * Cursor position will be set at (0, 1).
          *
-         * @param topology Circuit Topology.
+         * @param shared_topology Circuit Topology, which is shared with this circuit if finalized.
+         * Otherwise, a finalized copy of it is made.
+         * @param init_qubits Initial qubit states for each site.
          * @param physical_indices Physical (on-site) indices.
          * If not specified, the indices will be initialized with new IDs.
          * This argument is mainly used to share physical indices among
          * some "replica" wave functions in the same circuit.
          **/
+        QCircuit(std::shared_ptr<const CircuitTopology> shared_topology,
+                 const std::vector<std::pair<std::complex<double>, std::complex<double>>>& init_qubits,
+                 const std::vector<Index>& physical_indices = std::vector<Index>()) :
+            s(physical_indices),
+            shared_topology(finalizedTopology(shared_topology)),
+            topology(*this->shared_topology),
+            random_engine(std::random_device()()) {
+
+            if(!topology.isConnectedGraph()) {
+                throw QCircuitException("Invalid circuit topology : Some nodes are unreachable");
+            }
+            if(init_qubits.size() != this->size()) {
+                throw QCircuitException("Invalid initial state : The number of qubits does not match the topology");
+            }
+            contraction_plan = topology.getContractionPlan();
+
+            workspace = SingularValueWorkspace(topology.numberOfLinks());
+            truncation_errors.resize(topology.numberOfLinks());
+            link_bytes.resize(topology.numberOfLinks());
+            site_bytes.resize(this->size());
+            stats.reset(std::vector<long>(topology.numberOfLinks(), 1));
+
+            /* Initialize physical indices */
+            if(s.empty()) {
+                s.reserve(this->size());
+                for(size_t i = 0;i < this->size();i++) {
+                    s.emplace_back(2, "SiteInd");
+                }
+            }
+
+            layout.resize(this->size());
+            std::iota(layout.begin(), layout.end(), 0);
+            qubit_at = layout;
+
+            initializeProductState(init_qubits);
+            markInitialState();
+        }
+
+        /** @brief Constructor with a copy of `topology` (see the constructor above). */
         QCircuit(const CircuitTopology& topology,
+                 const std::vector<std::pair<std::complex<double>, std::complex<double>>>& init_qubits,
+                 const std::vector<Index>& physical_indices = std::vector<Index>()) :
+            QCircuit(std::make_shared<const CircuitTopology>(topology.finalizedCopy()), init_qubits, physical_indices) {}
+
+        /** @brief Constructor to initialize TPS wave function with |000 ... 000>.
+         *
+         * Cursor position will be set at (0, 1).
+         *
+         * @param shared_topology Circuit Topology, which is shared with this circuit if finalized.
+         * @param physical_indices Physical (on-site) indices.
+         * If not specified, the indices will be initialized with new IDs.
+         * This argument is mainly used to share physical indices among
+         * some "replica" wave functions in the same circuit.
+         **/
+        QCircuit(std::shared_ptr<const CircuitTopology> shared_topology,
                  const std::vector<Index>& physical_indices = std::vector<Index>()) :
-            QCircuit(topology,
-                     std::vector<std::pair<std::complex<double>, std::complex<double>>>(topology.numberOfBits(), std::make_pair(1.0, 0.0)),
+            QCircuit(shared_topology,
+                     std::vector<std::pair<std::complex<double>, std::complex<double>>>(shared_topology ? shared_topology->numberOfBits() : 0, std::make_pair(1.0, 0.0)),
                      physical_indices) {}
 
+        QCircuit(const CircuitTopology& topology,
+                 const std::vector<Index>& physical_indices = std::vector<Index>()) :
+            QCircuit(std::make_shared<const CircuitTopology>(topology.finalizedCopy()), physical_indices) {}
+
         /** @brief returns number of qubits */
         size_t size() const {
             return this->topology.numberOfBits();
         }
 
-        /** @brief update `Psi` (canonical center) with current cursor position */
+        /**
+         * @brief sets `Psi` from the tensor of the site `staying` with all its singular values absorbed
+         * and the site tensor of `entering`, which is equal to `updatePsi()`.
+         *
+         * Only the outer singular values of `entering` are multiplied.
+         */
+        void mergePsi(const ITensor& absorbed_staying, size_t staying, size_t entering) {
+            psi_dirty = false;
+
+            size_t link_index = topology.getLinkIdBetween(staying, entering);
+
+            Psi = absorbed_staying*M[entering];
+            for(auto&& neighbor : topology.neighborsOf(entering)) {
+                if(neighbor.link != link_index) {
+                    absorbSingularValues(Psi, neighbor.link);
+                }
+            }
+        }
+
+        /**
+         * @brief multiplies `T` by `SV[link]` in place, i.e. replaces the index of `link` in `T`
+         * by the other index of `SV[link]` and scales its slices.
+         */
+        void absorbSingularValues(ITensor& T, size_t link) const {
+            const Index from = commonIndex(T, SV[link]);
+            const Index to = uniqueIndex(SV[link], T);
+            gate_kernels::contractDiagonal(T, from, to, workspace.valuesAt(link));
+        }
+
+        /**
+         * @brief update `Psi` (canonical center) with current cursor position
+         *
+         * Singular values are absorbed in place (see `SingularValueWorkspace`),
+         * so only the copy of `M[cursor.first]` and the contraction allocate tensors.
+         */
         void updatePsi() {
-            size_t link_index = topology.getLinkIdBetween(cursor.first, cursor.second);
+            psi_dirty = false;
 
-            Psi = M[cursor.first]*SV[link_index]*M[cursor.second];
+            size_t link_index = topology.getLinkIdBetween(cursor.first, cursor.second);
 
             // add singular-value matrices at egdes
+            ITensor left = M[cursor.first];
             for(auto&& neighbor : topology.neighborsOf(cursor.first)) {
-                if(neighbor.link != link_index) {
-                    Psi = Psi*SV[neighbor.link];
-                }
+                absorbSingularValues(left, neighbor.link);
             }
+            Psi = left*M[cursor.second];
             for(auto&& neighbor : topology.neighborsOf(cursor.second)) {
                 if(neighbor.link != link_index) {
-                    Psi = Psi*SV[neighbor.link];
+                    absorbSingularValues(Psi, neighbor.link);
                 }
             }
         }
@@ -203,10 +391,78 @@ namespace qcircuit {
          *
          */
         Spectrum decomposePsi(const Args& args) {
-            const double SINGULAR_VALUE_THRESHOLD = 1e-16;
-            // Very small singular values could cause numerical instability
-            // when calculating inverse of them.
-            // This value is used as the threshold to discard such small singular values.
+            return decomposePsi(args, nullptr, nullptr);
+        }
+
+        /**
+         * @brief `decomposePsi()` which also returns the new site tensors of the cursor sites
+         * with all their singular values absorbed (see `factorizePsi()`).
+         */
+        Spectrum decomposePsi(const Args& args, ITensor* absorbed_first, ITensor* absorbed_second) {
+            flushPendingGates();
+
+#ifdef QCIRCUIT_STATS
+            const auto start = std::chrono::steady_clock::now();
+            const size_t psi_size = dim(inds(Psi));
+#endif
+
+            ITensor U, S, V;
+            Spectrum spec;
+            if(memory_budget > 0) {
+                Args budgeted_args = args;
+                long max_dim = budgetedMaxDim();
+                if(args.getInt("MaxDim", 0) > 0) {
+                    max_dim = std::min<long>(max_dim, args.getInt("MaxDim"));
+                }
+                budgeted_args.add("MaxDim", max_dim);
+                spec = factorizePsi(U, S, V, budgeted_args, absorbed_first, absorbed_second);
+            } else {
+                spec = factorizePsi(U, S, V, args, absorbed_first, absorbed_second);
+            }
+            last_truncation_error = spec.truncerr();
+
+            auto link_index = topology.getLinkIdBetween(cursor.first, cursor.second);
+            SV[link_index] = S;
+            workspace.update(link_index, S);
+            M[cursor.first] = U;
+            M[cursor.second] = V;
+            psi_dirty = false;
+
+            truncation_errors[link_index] = spec.truncerr();
+            link_bytes[link_index] = bondDimension(link_index)*sizeof(Real);
+            site_bytes[cursor.first] = siteTensorBytes(U);
+            site_bytes[cursor.second] = siteTensorBytes(V);
+
+#ifdef QCIRCUIT_STATS
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            stats.recordDecomposition(link_index, psi_size, bondDimension(link_index), spec.truncerr(), elapsed.count());
+#endif
+
+            return spec;
+        }
+
+        /**
+         * @brief factorizes `Psi` into `U`, `S` and `V` as `decomposePsi()` does,
+         * without modifying the circuit.
+         *
+         * `U` and `V` are the new site tensors of the first and the second cursor site,
+         * and `S` is the new singular-value tensor between them.
+         * The backend is selected by "Decomposition" in `args` (see `Decomposition`).
+         */
+        Spectrum factorizePsi(ITensor& U, ITensor& S, ITensor& V, const Args& args) const {
+            return factorizePsi(U, S, V, args, nullptr, nullptr);
+        }
+
+        /**
+         * @brief `factorizePsi()` which also returns the factors before the outer singular values are
+         * divided out, i.e. the site tensors with all their singular values absorbed.
+         *
+         * `*absorbed_U` is `U*S` times the outer singular values of the first cursor site,
+         * and `*absorbed_V` is the same for the second one. Null pointers are ignored.
+         */
+        Spectrum factorizePsi(ITensor& U, ITensor& S, ITensor& V, const Args& args,
+                              ITensor* absorbed_U, ITensor* absorbed_V) const {
+            const ITensor psi = currentPsi();
 
             /* Prepare indices to be free ones of U */
             auto link_index = topology.getLinkIdBetween(cursor.first, cursor.second);
@@ -215,63 +471,38 @@ namespace qcircuit {
             outer_indices_U.push_back(s[cursor.first]);
             for(auto&& neighbor : topology.neighborsOf(cursor.first)) {
                 if(neighbor.link != link_index) {
-                    outer_indices_U.push_back(commonIndex(Psi, SV[neighbor.link]));
+                    outer_indices_U.push_back(commonIndex(psi, SV[neighbor.link]));
                 }
             }
 
-            ITensor U, S, V;
             U = ITensor(outer_indices_U);
 
-            Spectrum spec = svd(Psi, U, S, V, args);
+            Spectrum spec = Decomposition::decompose(psi, U, S, V, args);
 
             S /= norm(S); // normalization
 
-            /* Reconstruct U */
-            for(auto&& neighbor : topology.neighborsOf(cursor.first)) {
-                if(neighbor.link != link_index) {
-                    Index index_i = uniqueIndex(SV[neighbor.link], U);
-                    Index index_j = commonIndex(U, SV[neighbor.link]); // to be contracted
-
-                    ITensor inv(prime(index_j), index_i);
-                    for(auto i : range1(std::min(dim(index_i), dim(index_j)))) {
-                        // Singular-value matrix has only diagonal elements, so just invert them
-
-                        auto x = SV[neighbor.link].real(index_i=i, index_j=i);
-                        if(x < SINGULAR_VALUE_THRESHOLD) {
-                            break; // SVs are in descending order, so discard remaining ones
-                        }
-                        inv.set(prime(index_j)=i, index_i=i, 1.0/x);
-                    }
-                    U.prime(index_j);
-                    U = U*inv;
-                }
+            if(absorbed_U != nullptr) {
+                *absorbed_U = U*S;
+            }
+            if(absorbed_V != nullptr) {
+                *absorbed_V = S*V;
             }
 
-            /* Reconstruct V */
-            for(auto&& neighbor : topology.neighborsOf(cursor.second)) {
-                if(neighbor.link != link_index) {
-                    Index index_i = uniqueIndex(SV[neighbor.link], V);
-                    Index index_j = commonIndex(V, SV[neighbor.link]); // to be contracted
-
-                    ITensor inv(prime(index_j), index_i);
-                    for(auto i : range1(std::min(dim(index_i), dim(index_j)))) {
-                        // Singular-value matrix has only diagonal elements, so just invert them
-
-                        auto x = SV[neighbor.link].real(index_i=i, index_j=i);
-                        if(x < SINGULAR_VALUE_THRESHOLD) {
-                            break; // SVs are in descending order, so discard remaining ones
-                        }
-                        inv.set(prime(index_j)=i, index_i=i, 1.0/x);
+            /* Reconstruct U and V by multiplying the inverse of outer singular values.
+             * Both of them are diagonal, so this is a scaling of each slice.
+             */
+            auto reconstruct = [this, &link_index](ITensor& X, size_t site) {
+                for(auto&& neighbor : topology.neighborsOf(site)) {
+                    if(neighbor.link != link_index) {
+                        Index index_i = uniqueIndex(SV[neighbor.link], X);
+                        Index index_j = commonIndex(X, SV[neighbor.link]); // to be contracted
 
+                        gate_kernels::contractDiagonal(X, index_j, index_i, workspace.inversesAt(neighbor.link));
                     }
-                    V.prime(index_j);
-                    V = V*inv;
                 }
-            }
-
-            SV[link_index] = S;
-            M[cursor.first] = U;
-            M[cursor.second] = V;
+            };
+            reconstruct(U, cursor.first);
+            reconstruct(V, cursor.second);
 
             return spec;
         }
@@ -284,6 +515,10 @@ namespace qcircuit {
          *
          * `direction` specifies which site of the cursor position to be used as the "head" of move.
          * `direction == 0` means not specifying the direction.
+         *
+         * If `Psi` has not been modified since it was merged from `M` and `SV`,
+         * the decomposition is skipped, since it would just reproduce them up to a gauge.
+         * The returned spectrum is empty in that case.
          */
         Spectrum shiftCursorTo(size_t dest, int direction, const Args& args) {
             const static int AUTO_HEAD = 0;
@@ -294,6 +529,10 @@ namespace qcircuit {
             assert(dest != cursor.second);
             assert(direction == AUTO_HEAD || direction == FIRST_AS_HEAD || direction == SECOND_AS_HEAD);
 
+#ifdef QCIRCUIT_STATS
+            stats.recordCursorHop();
+#endif
+
             if(direction == AUTO_HEAD) {
                 //first
                 for(auto&& i : topology.neighborsOf(cursor.first)) {
@@ -312,24 +551,40 @@ namespace qcircuit {
             }
 
 
-            Spectrum spec = decomposePsi();
+            /* The site staying under the cursor keeps its tensor with the singular values absorbed,
+             * so only the entering site is merged and the staying one is not divided and multiplied again.
+             */
+            Spectrum spec;
+            ITensor absorbed_first, absorbed_second;
+            const bool decomposed = psi_dirty;
+            if(decomposed) {
+                spec = decomposePsi(args, &absorbed_first, &absorbed_second);
+            }
 
 
             switch(direction) {
             case FIRST_AS_HEAD:
                 cursor.second = cursor.first;
                 cursor.first = dest;
+                if(decomposed) {
+                    mergePsi(absorbed_first, cursor.second, dest);
+                }
                 break;
             case SECOND_AS_HEAD:
                 cursor.first = cursor.second;
                 cursor.second = dest;
+                if(decomposed) {
+                    mergePsi(absorbed_second, cursor.first, dest);
+                }
                 break;
             default:
                 assert(false && "cannot move to this direction");
                 break;
             }
 
-            updatePsi();
+            if(!decomposed) {
+                updatePsi();
+            }
 
             return spec;
         }
@@ -381,7 +636,12 @@ namespace qcircuit {
             moveCursorTo(destination1, destination2, default_args);
         }
 
-        /** @brief applies `op` at cursor position. */
+        /**
+         * @brief applies `op` at cursor position.
+         *
+         * If gate fusion is enabled, `op` is multiplied into the pending operator
+         * and applied to `Psi` later (see `setGateFusion()`).
+         */
         void applyAtCursor(const ITensor& op) {
             assert(op.inds().size() == 4);
             for(auto&& elem : op.inds()){
@@ -389,7 +649,111 @@ namespace qcircuit {
                 assert(elem == s[cursor.first] || elem == s[cursor.second] || elem == prime(s[cursor.first]) || elem == prime(s[cursor.second]));
             }
 
-            this->Psi = op * prime(Psi, s[cursor.first], s[cursor.second]);
+            psi_dirty = true;
+            if(!gate_fusion) {
+                this->Psi = op * prime(Psi, s[cursor.first], s[cursor.second]);
+                return;
+            }
+
+            if(!pending_op) {
+                pending_op = op;
+            } else {
+                // (op * pending_op)(s, s'') is stored as (s, s')
+                pending_op = mapPrime(op * prime(pending_op), 2, 1);
+            }
+        }
+
+        /**
+         * @brief contracts one-site operator `op` into the site tensor at `site`,
+         * which must not be under the cursor.
+         *
+         * `op` should be unitary for the decomposed wave function to be kept normalized.
+         */
+        void applyToSite(size_t site, const ITensor& op) {
+            assert(site != cursor.first && site != cursor.second);
+            assert(op.inds().size() == 2);
+
+            M[site] = op * prime(M[site], s[site]);
+        }
+
+        /**
+         * @brief applies the matrix of `gate` to `Psi` in place with the kernels of `gate_kernels`.
+         *
+         * The sites of `gate` must be under the cursor.
+         */
+        void applyKernelAtCursor(const OneSiteGate& gate) {
+            assert(gate.site == cursor.first || gate.site == cursor.second);
+            if(typeid(gate) == typeid(Id)) {
+                return;
+            }
+            psi_dirty = true;
+            gate_kernels::apply<1>(Psi, gate.matrix(), {s[gate.site]});
+        }
+
+        void applyKernelAtCursor(const TwoSiteGate& gate) {
+            assert((gate.site1 == cursor.first && gate.site2 == cursor.second) || (gate.site1 == cursor.second && gate.site2 == cursor.first));
+            psi_dirty = true;
+            gate_kernels::apply<2>(Psi, gate.matrix(), {s[gate.site1], s[gate.site2]});
+        }
+
+        /**
+         * @brief exchanges the states of the two sites under the cursor, i.e. applies `Swap`,
+         * by exchanging the physical indices of `Psi` without any arithmetic.
+         */
+        void swapAtCursor() {
+            flushPendingGates();
+            psi_dirty = true;
+            Psi.swapInds(IndexSet(s[cursor.first]), IndexSet(s[cursor.second]));
+        }
+
+        /** @brief returns whether gates at cursor position are applied with `applyKernelAtCursor()`. */
+        bool kernelsActive() const {
+            return use_gate_kernels && !gate_fusion;
+        }
+
+        /** @brief applies the pending fused operator, if any, to `Psi`. */
+        void flushPendingGates() {
+            if(pending_op) {
+                this->Psi = pending_op * prime(Psi, s[cursor.first], s[cursor.second]);
+                pending_op = ITensor();
+            }
+        }
+
+        /** @brief returns `Psi` including the pending fused operator. */
+        ITensor currentPsi() const {
+            if(pending_op) {
+                return pending_op * prime(Psi, s[cursor.first], s[cursor.second]);
+            }
+            return Psi;
+        }
+
+        /**
+         * @brief counts `gate` in the statistics if `QCIRCUIT_STATS` is defined.
+         *
+         * Gates are counted by the public `apply()` overloads only,
+         * so that the identity gates applied to dummy sites are not counted.
+         */
+        void recordGate(const Gate& gate) {
+#ifdef QCIRCUIT_STATS
+            stats.recordGate(typeid(gate));
+#else
+            (void)gate;
+#endif
+        }
+
+        /** @brief applies one-site gates `gate1` and `gate2` at the cursor without counting them. */
+        void applyPairAtCursor(const OneSiteGate& gate1,
+                               const OneSiteGate& gate2,
+                               const Args& args) {
+            moveCursorTo(gate1.site, gate2.site, args);
+            if(kernelsActive()) {
+                applyKernelAtCursor(gate1);
+                applyKernelAtCursor(gate2);
+                return;
+            }
+            ITensor op = cachedTensorOp(gate1); // copied, since the next lookup may invalidate the reference
+            op *= cachedTensorOp(gate2);
+            applyAtCursor(op);
         }
 
         /**
@@ -400,9 +764,9 @@ namespace qcircuit {
         void apply(const OneSiteGate& gate1,
                    const OneSiteGate& gate2,
                    const Args& args) {
-            moveCursorTo(gate1.site, gate2.site, args);
-            auto op = generateTensorOp(gate1) * generateTensorOp(gate2);
-            applyAtCursor(op);
+            recordGate(gate1);
+            recordGate(gate2);
+            applyPairAtCursor(gate1, gate2, args);
         }
 
         void apply(const OneSiteGate& gate1,
@@ -411,15 +775,24 @@ namespace qcircuit {
         }
 
         /**
-         * @brief applies one-site gates `gate1` onto the gate position and
-         * identity gate onto a dummy site.
+         * @brief applies one-site gates `gate1` onto the gate position.
          *
-         * Cursor position will be automatically moved.
+         * If `gate1` is unitary and its site is not under the cursor,
+         * the gate is contracted directly into the site tensor, and the cursor does not move,
+         * since a unitary acting on the physical index does not change the bond structure.
+         * Otherwise, `gate1` is applied at the cursor together with identity gate onto a dummy site,
+         * and the cursor position will be automatically moved.
          */
         void apply(const OneSiteGate& gate1, const Args& args) {
-            Id gate2(topology.neighborsOf(gate1.site)[0].site);
+            recordGate(gate1);
+            if(gate1.isUnitary() && gate1.site != cursor.first && gate1.site != cursor.second) {
+                applyToSite(gate1.site, cachedTensorOp(gate1));
+                return;
+            }
 
-            this->apply(gate1, gate2, args);
+            Id gate2(dummyNeighborOf(gate1.site));
+
+            applyPairAtCursor(gate1, gate2, args);
         }
 
         void apply(const OneSiteGate& gate1) {
@@ -432,38 +805,264 @@ namespace qcircuit {
          * Cursor position will be automatically moved.
          */
         void apply(const TwoSiteGate& gate, const Args& args) {
+            recordGate(gate);
             moveCursorTo(gate.site1, gate.site2, args);
-            auto op = generateTensorOp(gate);
-            applyAtCursor(op);
+            if(typeid(gate) == typeid(Swap)) {
+                swapAtCursor();
+                return;
+            }
+            if(kernelsActive()) {
+                applyKernelAtCursor(gate);
+                return;
+            }
+            applyAtCursor(cachedTensorOp(gate));
         }
 
         void apply(const TwoSiteGate& gate) {
             apply(gate, default_args);
         }
 
-        /** @brief returns the tensor operator corresponding to `gate`. */
-        ITensor generateTensorOp(const Gate& gate) const {
-            return gate.op(s);
+        /**
+         * @brief applies `gate`, dispatching to the one-site or two-site overload.
+         */
+        void apply(const Gate& gate, const Args& args) {
+            if(auto two_site = dynamic_cast<const TwoSiteGate*>(&gate)) {
+                apply(*two_site, args);
+            } else if(auto one_site = dynamic_cast<const OneSiteGate*>(&gate)) {
+                apply(*one_site, args);
+            } else {
+                throw QCircuitException("Unsupported gate type");
+            }
         }
 
-        /**
-          * @brief returns probability the qubit at `site` to be observed as value `expected` (0 or 1),
-          * i.e. `<psi|Proj_X(i)|psi>` as "Born rule".
-          */
-        double probabilityOf(size_t site, int expected) const {
-            assert(expected == 0 | expected == 1);
+        void apply(const Gate& gate) {
+            apply(gate, default_args);
+        }
 
-            std::vector<ITensor> op;
-            op.reserve(this->size());
-            for(size_t i = 0;i < this->size();i++) {
-                if(i == site) {
-                    if(expected == 0) {
-                        op.push_back(generateTensorOp(Proj_0(i)));
-                    } else {
-                        op.push_back(generateTensorOp(Proj_1(i)));
-                    }
-                } else {
-                    op.push_back(generateTensorOp(Id(i)));
+        /**
+         * @brief applies `count` gates encoded in the contiguous array `specs` in order.
+         *
+         * This is equivalent to calling `apply()` for each gate,
+         * without constructing a heap-allocated gate object per gate.
+         */
+        void applyAll(const GateSpec* specs, size_t count, const Args& args) {
+            const size_t num_bits = topology.numberOfBits();
+            for(size_t k = 0;k < count;k++) {
+                // two-site opcodes follow the one-site ones
+                bool two_site = specs[k].opcode >= static_cast<std::int32_t>(GateOpcode::CNOT);
+                if(specs[k].site1 >= num_bits || (two_site && specs[k].site2 >= num_bits)) {
+                    std::stringstream ss;
+                    ss << "Site of gate " << k << " is out of range";
+                    throw QCircuitException(ss.str());
+                }
+                visitGate(specs[k], [this, &args](const auto& gate) {
+                    this->apply(gate, args);
+                });
+            }
+        }
+
+        void applyAll(const GateSpec* specs, size_t count) {
+            applyAll(specs, count, default_args);
+        }
+
+        void applyAll(const std::vector<GateSpec>& specs, const Args& args) {
+            applyAll(specs.data(), specs.size(), args);
+        }
+
+        void applyAll(const std::vector<GateSpec>& specs) {
+            applyAll(specs.data(), specs.size(), default_args);
+        }
+
+        /** @brief returns the site of the logical qubit `qubit`. */
+        size_t siteOf(size_t qubit) const {
+            return layout[qubit];
+        }
+
+        /** @brief returns the logical qubit at `site`. */
+        size_t qubitAt(size_t site) const {
+            return qubit_at[site];
+        }
+
+        /** @brief returns the site of each logical qubit. */
+        const std::vector<size_t>& getLayout() const {
+            return layout;
+        }
+
+        /**
+         * @brief swaps the logical qubits `qubit1` and `qubit2`, i.e. `Swap` in logical addressing,
+         * by exchanging their sites in the layout. No tensor is touched.
+         */
+        void relabelQubits(size_t qubit1, size_t qubit2) {
+            std::swap(layout[qubit1], layout[qubit2]);
+            qubit_at[layout[qubit1]] = qubit1;
+            qubit_at[layout[qubit2]] = qubit2;
+        }
+
+        /**
+         * @brief moves the states of the neighboring sites `site1` and `site2` into each other,
+         * keeping the logical state, i.e. the logical qubits follow their states.
+         *
+         * This is a physical `Swap` followed by `relabelQubits()`.
+         * The cursor is moved onto the sites. The `Swap` itself only exchanges the physical indices
+         * of `Psi`, but it modifies `Psi`, so the next cursor shift decomposes it.
+         */
+        void exchangeSites(size_t site1, size_t site2, const Args& args) {
+            apply(Swap(site1, site2), args);
+            relabelQubits(qubit_at[site1], qubit_at[site2]);
+        }
+
+        void exchangeSites(size_t site1, size_t site2) {
+            exchangeSites(site1, site2, default_args);
+        }
+
+        /**
+         * @brief applies the gate encoded in `spec` on logical qubits.
+         *
+         * The sites of `spec` are logical qubits, which are mapped to sites by the layout (see `siteOf()`).
+         * - `Swap` is done by `relabelQubits()`, so it costs neither a contraction nor a decomposition.
+         * - For a two-site gate on qubits which are not on neighboring sites,
+         *   the second qubit is moved next to the first one by `exchangeSites()` along `getSwapPath()`,
+         *   and stays there. Each hop costs one decomposition, as a physical `Swap` chain does;
+         *   only the swap back is saved.
+         *
+         * The layout starts as the identity, so the logical and the physical addressing agree
+         * until a logical `Swap` or a routed gate is applied.
+         */
+        void applyLogical(const GateSpec& spec, const Args& args) {
+            const size_t num_bits = topology.numberOfBits();
+            bool two_site = spec.opcode >= static_cast<std::int32_t>(GateOpcode::CNOT);
+            if(spec.site1 >= num_bits || (two_site && spec.site2 >= num_bits)) {
+                throw QCircuitException("Logical qubit of gate is out of range");
+            }
+
+            if(static_cast<GateOpcode>(spec.opcode) == GateOpcode::Swap) {
+                relabelQubits(spec.site1, spec.site2);
+                return;
+            }
+
+            GateSpec physical = spec;
+            physical.site1 = static_cast<std::uint32_t>(layout[spec.site1]);
+            if(two_site) {
+                if(!topology.hasLinkBetween(layout[spec.site1], layout[spec.site2])) {
+                    auto path = getSwapPath(layout[spec.site1], layout[spec.site2]);
+                    for(size_t i = 0;i+1 < path.size();i++) {
+                        exchangeSites(path[i], path[i+1], args);
+                    }
+                }
+                physical.site2 = static_cast<std::uint32_t>(layout[spec.site2]);
+            }
+            visitGate(physical, [this, &args](const auto& gate) {
+                this->apply(gate, args);
+            });
+        }
+
+        void applyLogical(const GateSpec& spec) {
+            applyLogical(spec, default_args);
+        }
+
+        /** @brief applies `count` gates encoded in `specs` on logical qubits in order (see `applyLogical()`). */
+        void applyAllLogical(const GateSpec* specs, size_t count, const Args& args) {
+            for(size_t k = 0;k < count;k++) {
+                applyLogical(specs[k], args);
+            }
+        }
+
+        void applyAllLogical(const GateSpec* specs, size_t count) {
+            applyAllLogical(specs, count, default_args);
+        }
+
+        void applyAllLogical(const std::vector<GateSpec>& specs, const Args& args) {
+            applyAllLogical(specs.data(), specs.size(), args);
+        }
+
+        void applyAllLogical(const std::vector<GateSpec>& specs) {
+            applyAllLogical(specs.data(), specs.size(), default_args);
+        }
+
+        /**
+         * @brief applies `gates` in the order chosen by `CursorScheduler` to reduce decompositions
+         * and cursor shifts.
+         *
+         * Non-commuting gates are kept in the given order, so the resulting state is the same
+         * as applying `gates` one by one, up to truncation errors.
+         *
+         * @return Numbers of decompositions and cursor shifts in the given order and in the applied order.
+         */
+        CursorScheduler::Report applyScheduled(const std::vector<const Gate*>& gates, const Args& args) {
+            CursorScheduler scheduler(topology);
+            auto order = scheduler.schedule(cursor, gates, psi_dirty);
+            auto report = scheduler.report(cursor, gates, order, psi_dirty);
+            for(auto j : order) {
+                apply(*gates[j], args);
+            }
+            return report;
+        }
+
+        CursorScheduler::Report applyScheduled(const std::vector<const Gate*>& gates) {
+            return applyScheduled(gates, default_args);
+        }
+
+        /**
+         * @brief returns a neighboring site of `site` to which a dummy identity operator is applied
+         * together with a one-site operator on `site`.
+         *
+         * If `site` is under the cursor, the other cursor site is returned so that the cursor does not move.
+         */
+        size_t dummyNeighborOf(size_t site) const {
+            if(site == cursor.first) {
+                return cursor.second;
+            }
+            if(site == cursor.second) {
+                return cursor.first;
+            }
+            return topology.neighborsOf(site)[0].site;
+        }
+
+        /** @brief projects the qubit at `site` onto |`bit`> at the cursor and normalizes the state. */
+        void projectQubit(size_t site, int bit, const Args& args) {
+            size_t neighbor = dummyNeighborOf(site); // Dummy site to which Id operator is applied.
+            if(bit == 0) {
+                recordGate(Proj_0(site));
+                applyPairAtCursor(Proj_0(site), Id(neighbor), args);
+            } else {
+                recordGate(Proj_1(site));
+                applyPairAtCursor(Proj_1(site), Id(neighbor), args);
+            }
+            this->normalize();
+        }
+
+        /** @brief returns the tensor operator corresponding to `gate`. */
+        ITensor generateTensorOp(const Gate& gate) const {
+            return gate.op(s);
+        }
+
+        /**
+         * @brief returns the tensor operator corresponding to `gate` from the gate cache of this circuit.
+         *
+         * The returned reference is valid until the next call of this function.
+         */
+        const ITensor& cachedTensorOp(const Gate& gate) {
+            return gate_cache.op(gate, s);
+        }
+
+        /**
+          * @brief returns probability the qubit at `site` to be observed as value `expected` (0 or 1),
+          * i.e. `<psi|Proj_X(i)|psi>` as "Born rule".
+          */
+        double probabilityOf(size_t site, int expected) const {
+            assert(expected == 0 | expected == 1);
+
+            std::vector<ITensor> op;
+            op.reserve(this->size());
+            for(size_t i = 0;i < this->size();i++) {
+                if(i == site) {
+                    if(expected == 0) {
+                        op.push_back(generateTensorOp(Proj_0(i)));
+                    } else {
+                        op.push_back(generateTensorOp(Proj_1(i)));
+                    }
+                } else {
+                    op.push_back(generateTensorOp(Id(i)));
                 }
             }
 
@@ -482,6 +1081,258 @@ namespace qcircuit {
             return probabilityOf(site, 0);
         }
 
+        /**
+         * @brief returns site tensors ready for network contraction, leaving the circuit untouched.
+         *
+         * `Psi` is factorized at the cursor position (see `factorizePsi()`), and
+         * each singular-value tensor is absorbed into the site tensor of the smaller-numbered end
+         * of its link, so that contracting all the returned tensors reproduces the wave function.
+         */
+        std::vector<ITensor> contractionTensors(const Args& args) const {
+            std::vector<ITensor> ret(M);
+
+            ITensor U, S, V;
+            factorizePsi(U, S, V, args);
+            ret[cursor.first] = U;
+            ret[cursor.second] = V;
+
+            auto link_index = topology.getLinkIdBetween(cursor.first, cursor.second);
+            for(size_t i = 0;i < this->size();i++) {
+                for(auto&& neighbor : topology.neighborsOf(i)) {
+                    if(i < neighbor.site) {
+                        if(neighbor.link == link_index) {
+                            ret[i] *= S;
+                        } else {
+                            absorbSingularValues(ret[i], neighbor.link);
+                        }
+                    }
+                }
+            }
+
+            return ret;
+        }
+
+        std::vector<ITensor> contractionTensors() const {
+            return contractionTensors(default_args);
+        }
+
+        /**
+         * @brief returns site tensors whose contraction reproduces the wave function, without decomposing `Psi`.
+         *
+         * The tensor of `cursor.first` is `Psi` (including the pending fused operator),
+         * and that of `cursor.second` is a scalar 1, since `Psi` covers both cursor sites.
+         * The singular-value tensors not included in `Psi` are absorbed into the site tensor
+         * of the smaller-numbered end of each link.
+         * Unlike `contractionTensors()`, each cursor site does not have its own tensor,
+         * so this is for contracting the whole network as `overlap()` does.
+         */
+        std::vector<ITensor> networkTensors() const {
+            std::vector<ITensor> ret(M);
+            auto on_cursor = [this](size_t site) {
+                return site == cursor.first || site == cursor.second;
+            };
+
+            for(size_t i = 0;i < this->size();i++) {
+                if(on_cursor(i)) {
+                    continue;
+                }
+                for(auto&& neighbor : topology.neighborsOf(i)) {
+                    // Singular values of the links at the cursor sites are in `Psi`.
+                    if(i < neighbor.site && !on_cursor(neighbor.site)) {
+                        absorbSingularValues(ret[i], neighbor.link);
+                    }
+                }
+            }
+            ret[cursor.first] = currentPsi();
+            ret[cursor.second] = ITensor(1.0);
+
+            return ret;
+        }
+
+        /**
+         * @brief returns the probability of every qubit to be observed as value `expected` (0 or 1).
+         *
+         * Unlike calling `probabilityOf()` for each site, the environment of the network is
+         * built only once and reused for all the sites.
+         * Returned probabilities are normalized by <psi|psi>.
+         */
+        std::vector<double> marginalProbabilities(int expected = 0) const {
+            assert(expected == 0 || expected == 1);
+
+            SweepEnvironment env(s, contractionTensors());
+
+            std::vector<double> ret;
+            ret.reserve(this->size());
+            for(size_t i = 0;i < this->size();i++) {
+                auto ret_t = SweepEnvironment::absorbProjected(env.left(i), env.siteTensor(i), s[i], expected)
+                    *env.right(i+1);
+                ret.push_back(std::real(ret_t.cplx())/env.squaredNorm());
+            }
+
+            return ret;
+        }
+
+        /**
+         * @brief returns <psi|gate|psi> / <psi|psi> of each one-site gate in `gates`.
+         *
+         * Each gate is evaluated independently, i.e. the k-th value is the expectation value
+         * of `gates[k]` alone. The environment of the network is shared among all the gates.
+         */
+        std::vector<Cplx> expectationValues(const std::vector<const OneSiteGate*>& gates) const {
+            SweepEnvironment env(s, contractionTensors());
+
+            std::vector<Cplx> ret;
+            ret.reserve(gates.size());
+            for(auto&& gate : gates) {
+                ret.push_back(env.localExpectation(gate->site, generateTensorOp(*gate)));
+            }
+
+            return ret;
+        }
+
+        /**
+         * @brief returns <psi|P|psi> / <psi|psi> of each Pauli string `P` in `terms`, without the coefficients.
+         *
+         * The factors of the terms act on sites (see `siteOf()` for logical qubits).
+         * The environment of the network is built once, and the contractions are shared among
+         * the terms (see `SweepEnvironment::pauliExpectations()`).
+         * `num_threads` threads evaluate the terms in parallel. 0 means the OpenMP default.
+         */
+        std::vector<Cplx> pauliExpectations(const std::vector<PauliString>& terms, int num_threads = 1) const {
+            return SweepEnvironment(s, contractionTensors()).pauliExpectations(terms, num_threads);
+        }
+
+        /** @brief returns the expectation value of the sum of `terms` with their coefficients, e.g. a Hamiltonian. */
+        Cplx expectation(const std::vector<PauliString>& terms, int num_threads = 1) const {
+            auto values = pauliExpectations(terms, num_threads);
+            Cplx ret = 0.0;
+            for(size_t k = 0;k < terms.size();k++) {
+                ret += terms[k].getCoefficient()*values[k];
+            }
+            return ret;
+        }
+
+        /**
+         * @brief draws `shots` bitstrings from the current state in the computational basis.
+         *
+         * The wave function is left untouched, so the state is not collapsed and can be sampled again.
+         * The environment of the network is built once and shared among all the shots.
+         *
+         * @param shots Number of bitstrings to be drawn.
+         * @param seed Seed of the random engine used for this sampling only.
+         * @return Row-major `shots` x `size()` array. The element `[k*size() + i]` is
+         * the value (0 or 1) of the qubit `i` in the k-th shot.
+         */
+        std::vector<std::uint8_t> sample(size_t shots, std::uint32_t seed) const {
+            std::mt19937 engine(seed);
+            return SweepEnvironment(s, contractionTensors()).sample(shots, engine);
+        }
+
+        /** @brief draws `shots` bitstrings with a seed taken from the random engine of the circuit. */
+        std::vector<std::uint8_t> sample(size_t shots) {
+            return sample(shots, static_cast<std::uint32_t>(random_engine()));
+        }
+
+        /**
+         * @brief seeds the random engine used by `observeQubit()` and `sample()`.
+         *
+         * The engine is seeded from `std::random_device` on construction.
+         */
+        void setSeed(std::uint32_t seed) {
+            random_engine.seed(seed);
+        }
+
+        /**
+         * @brief returns a copy of this circuit, e.g. to branch before a measurement.
+         *
+         * ITensor shares the storage of copied tensors and duplicates it only when it is modified,
+         * so this takes O(N) time and no tensor data are copied.
+         * A gate touches only the tensors at its sites, so forks diverge only in those tensors.
+         * The topology and the contraction plan are shared as well.
+         * The fork has the same state of the random engine as this circuit.
+         */
+        QCircuit fork() const {
+            return QCircuit(*this);
+        }
+
+        /** @brief returns a fork (see `fork()`) whose random engine is seeded with `seed`. */
+        QCircuit fork(std::uint32_t seed) const {
+            QCircuit ret(*this);
+            ret.setSeed(seed);
+            return ret;
+        }
+
+        /**
+         * @brief returns the circuit to its initial state, the product state given on construction
+         * (|0...0> by default) or the one recorded by `markInitialState()`.
+         *
+         * The tensors of the initial state are shared with this circuit, so no tensor is allocated.
+         * The qubit layout, the pending fused operator and the truncation errors are cleared.
+         * The settings (e.g. cutoff), the gate cache, the statistics and the random engine are kept.
+         */
+        void reset() {
+            M = initial_state->M;
+            SV = initial_state->SV;
+            Psi = initial_state->Psi;
+            cursor = initial_state->cursor;
+            pending_op = ITensor();
+            psi_dirty = initial_state->psi_dirty;
+
+            std::iota(layout.begin(), layout.end(), 0);
+            std::iota(qubit_at.begin(), qubit_at.end(), 0);
+
+            last_truncation_error = 0.0;
+            std::fill(truncation_errors.begin(), truncation_errors.end(), 0.0);
+            for(size_t link = 0;link < SV.size();link++) {
+                workspace.update(link, SV[link]);
+                link_bytes[link] = bondDimension(link)*sizeof(Real);
+            }
+            for(size_t i = 0;i < M.size();i++) {
+                site_bytes[i] = siteTensorBytes(M[i]);
+            }
+        }
+
+        /**
+         * @brief records the current state as the one restored by `reset()`.
+         *
+         * The tensors are shared with the circuit, so this takes O(N) time.
+         */
+        void markInitialState() {
+            flushPendingGates();
+            initial_state = std::make_shared<const InitialState>(InitialState{M, SV, Psi, cursor, psi_dirty});
+        }
+
+        /**
+         * @brief replaces the physical indices of this circuit (and of its initial state) by `physical_indices`,
+         * e.g. to make circuits with their own indices from one prototype (see `CircuitPrototype`).
+         */
+        void replacePhysicalIndices(const std::vector<Index>& physical_indices) {
+            if(physical_indices.size() != this->size()) {
+                throw QCircuitException("Invalid physical indices : The number of indices does not match the topology");
+            }
+            flushPendingGates();
+
+            auto replace = [this, &physical_indices](ITensor& T, size_t site) {
+                T.replaceInds(IndexSet(s[site]), IndexSet(physical_indices[site]));
+            };
+            for(size_t i = 0;i < this->size();i++) {
+                replace(M[i], i);
+            }
+            replace(Psi, cursor.first);
+            replace(Psi, cursor.second);
+
+            InitialState initial = *initial_state;
+            for(size_t i = 0;i < this->size();i++) {
+                replace(initial.M[i], i);
+            }
+            replace(initial.Psi, initial.cursor.first);
+            replace(initial.Psi, initial.cursor.second);
+            initial_state = std::make_shared<const InitialState>(std::move(initial));
+
+            s = physical_indices;
+            gate_cache.clear(); // cached operators act on the old indices
+        }
+
         /** @brief observes the qubit state at `site` and returns the projected qubit value (0 or 1). */
         int observeQubit(size_t site, const Args& args) {
             auto prob0 = probabilityOfZero(site);
@@ -489,14 +1340,7 @@ namespace qcircuit {
             std::uniform_real_distribution<> dist(0.0, 1.0);
             int state = (dist(random_engine) < prob0) ? 0 : 1; // measurement
 
-            size_t neighbor = topology.neighborsOf(site)[0].site; // Dummy site to which Id operator is applied.
-            if(state == 0) {
-                apply(Proj_0(site), Id(neighbor), args);
-            } else {
-                apply(Proj_1(site), Id(neighbor), args);
-            }
-            this->normalize();
-
+            projectQubit(site, state, args);
             return state;
         }
 
@@ -504,17 +1348,109 @@ namespace qcircuit {
             return observeQubit(site, default_args);
         }
 
-        /** @brief reset the qubit state at `site` to |0>. */
-        void resetQubit(size_t site, const Args& args) {
-            auto prob0 = probabilityOfZero(site);
+        /** @brief receives the outcome `bit` of the qubit at `site` once the state is projected onto it. */
+        using MeasurementCallback = std::function<void(size_t site, int bit)>;
 
-            size_t neighbor = topology.neighborsOf(site)[0].site; // Dummy site to which Id operator is applied.
-            if(prob0 > 0.0) {
-                apply(Proj_0(site), Id(neighbor), args);
-            } else {
-                apply(Proj_1(site), Id(neighbor), args);
+        /**
+         * @brief measures the qubits at `sites` and returns the outcomes (0 or 1) in the order of `sites`.
+         *
+         * Unlike calling `observeQubit()` for each site, which contracts the whole network per qubit,
+         * the joint outcome is drawn from one environment of the network
+         * (see `SweepEnvironment::sampleSites()`), so the probabilities cost O(N) contractions in total.
+         * Then the state is projected qubit by qubit, visiting the nearest remaining site
+         * from the cursor first, and `callback` (if any) is called after each projection.
+         * If all the sites are measured, the state is replaced by the product state of the outcomes
+         * without any projection, and the cursor returns to its initial position;
+         * the truncation errors recorded so far are kept.
+         */
+        std::vector<int> measure(const std::vector<size_t>& sites, const Args& args,
+                                 const MeasurementCallback& callback = MeasurementCallback()) {
+            std::vector<bool> measured(this->size(), false);
+            for(auto site : sites) {
+                if(site >= this->size() || measured[site]) {
+                    throw QCircuitException("Invalid measurement : Site out of range or measured twice");
+                }
+                measured[site] = true;
             }
-            this->normalize();
+            if(sites.empty()) {
+                return {};
+            }
+
+            auto bits = SweepEnvironment(s, contractionTensors(args)).sampleSites(sites, random_engine);
+
+            if(sites.size() == this->size()) {
+                std::vector<std::pair<std::complex<double>, std::complex<double>>> qubits(this->size());
+                for(size_t k = 0;k < sites.size();k++) {
+                    qubits[sites[k]] = (bits[k] == 0) ? std::make_pair(1.0, 0.0) : std::make_pair(0.0, 1.0);
+                }
+                initializeProductState(qubits);
+                if(callback) {
+                    for(size_t k = 0;k < sites.size();k++) {
+                        callback(sites[k], bits[k]);
+                    }
+                }
+                return bits;
+            }
+
+            std::vector<bool> projected(sites.size(), false);
+            for(size_t count = 0;count < sites.size();count++) {
+                size_t next = sites.size();
+                size_t shortest = 0;
+                for(size_t k = 0;k < sites.size();k++) {
+                    if(projected[k]) {
+                        continue;
+                    }
+                    auto length = topology.getRouteLength(cursor, std::make_pair(sites[k], sites[k]));
+                    if(next == sites.size() || length < shortest) {
+                        next = k;
+                        shortest = length;
+                    }
+                }
+                projected[next] = true;
+                projectQubit(sites[next], bits[next], args);
+                if(callback) {
+                    callback(sites[next], bits[next]);
+                }
+            }
+            return bits;
+        }
+
+        std::vector<int> measure(const std::vector<size_t>& sites,
+                                 const MeasurementCallback& callback = MeasurementCallback()) {
+            return measure(sites, default_args, callback);
+        }
+
+        /** @brief measures all the qubits (see `measure()`) and returns the outcome of each site. */
+        std::vector<int> measureAll(const Args& args, const MeasurementCallback& callback = MeasurementCallback()) {
+            std::vector<size_t> sites(this->size());
+            std::iota(sites.begin(), sites.end(), 0);
+            return measure(sites, args, callback);
+        }
+
+        std::vector<int> measureAll(const MeasurementCallback& callback = MeasurementCallback()) {
+            return measureAll(default_args, callback);
+        }
+
+        /**
+         * @brief resets the qubits at `sites` to |0>, by measuring them (see `measure()`)
+         * and flipping those observed as 1.
+         */
+        void resetQubits(const std::vector<size_t>& sites, const Args& args) {
+            auto bits = measure(sites, args);
+            for(size_t k = 0;k < sites.size();k++) {
+                if(bits[k] == 1) {
+                    apply(X(sites[k]), args);
+                }
+            }
+        }
+
+        void resetQubits(const std::vector<size_t>& sites) {
+            resetQubits(sites, default_args);
+        }
+
+        /** @brief reset the qubit state at `site` to |0> (see `resetQubits()`). */
+        void resetQubit(size_t site, const Args& args) {
+            resetQubits({site}, args);
         }
 
         void resetQubit(size_t site) {
@@ -564,11 +1500,306 @@ namespace qcircuit {
             return default_args.getInt("MaxDim", 0);
         }
 
+        /**
+         * @brief sets the decomposition backend of `decomposePsi()`, "Full" (default), "Randomized" or "Device".
+         *
+         * "Randomized" is effective only with `setMaxDim()`,
+         * and "Device" is available only if built with CUDA (see `Decomposition`).
+         */
+        QCircuit& setDecomposition(const std::string& method) {
+            if(!Decomposition::isValidMethod(method)) {
+                throw QCircuitException("Unknown decomposition method: " + method);
+            }
+            default_args.add("Decomposition", method);
+
+            return *this; // for method chaining
+        }
+
+        std::string getDecomposition() const {
+            return default_args.getString("Decomposition", "Full");
+        }
+
+        /** @brief returns the truncation error of the latest decomposition at the cursor. */
+        double getLastTruncationError() const {
+            return last_truncation_error;
+        }
+
+        /** @brief returns the truncation error of the latest decomposition of `link`. */
+        double getTruncationError(size_t link) const {
+            return truncation_errors.at(link);
+        }
+
+        /** @brief returns the truncation error of the latest decomposition of each link. */
+        const std::vector<double>& getTruncationErrors() const {
+            return truncation_errors;
+        }
+
+        /**
+         * @brief sets the memory budget in bytes for the site tensors and the singular values.
+         *
+         * With a nonzero budget, each decomposition chooses the bond dimension of the cursor link
+         * so that all the tensors fit in the budget, in addition to "Cutoff" and "MaxDim".
+         * Bonds are truncated harder when the rest of the network is large,
+         * and the truncation error of each link is available from `getTruncationErrors()`.
+         * The budget does not include `Psi` and temporary tensors of decompositions.
+         * 0 (default) means unbounded.
+         */
+        QCircuit& setMemoryBudget(size_t bytes) {
+            memory_budget = bytes;
+            return *this; // for method chaining
+        }
+
+        size_t getMemoryBudget() const {
+            return memory_budget;
+        }
+
+        /** @brief returns the current size of the site tensors and the singular values in bytes. */
+        size_t memoryUsage() const {
+            size_t ret = 0;
+            for(auto bytes : site_bytes) {
+                ret += bytes;
+            }
+            for(auto bytes : link_bytes) {
+                ret += bytes;
+            }
+            return ret;
+        }
+
+        /**
+         * @brief returns the size of the buffers of singular values and their inverses in bytes,
+         * which is not included in `memoryUsage()` (see `SingularValueWorkspace`).
+         */
+        size_t workspaceBytes() const {
+            return workspace.bytes();
+        }
+
+        /** @brief returns current bond dimension of each link. */
+        std::vector<long> bondDimensions() const {
+            std::vector<long> ret(SV.size());
+            for(size_t link = 0;link < SV.size();link++) {
+                ret[link] = bondDimension(link);
+            }
+            return ret;
+        }
+
+        /**
+         * @brief returns the counters of gates, decompositions and cursor hops (see `CircuitStats`).
+         *
+         * The counters are recorded only if `QCIRCUIT_STATS` is defined,
+         * which is checked by `CircuitStats::enabled()`.
+         */
+        const CircuitStats& getStats() const {
+            return stats;
+        }
+
+        void resetStats() {
+            stats.reset(bondDimensions());
+        }
+
+        /** @brief sets maximum number of tensor operators kept in the gate cache. */
+        QCircuit& setGateCacheCapacity(size_t capacity) {
+            gate_cache.setCapacity(capacity);
+            return *this; // for method chaining
+        }
+
+        size_t getGateCacheCapacity() const {
+            return gate_cache.getCapacity();
+        }
+
         void normalize() {
+            flushPendingGates();
             Psi /= norm(Psi);
+            psi_dirty = true;
+        }
+
+        /**
+         * @brief enables or disables gate fusion.
+         *
+         * If enabled, operators applied at the cursor position are multiplied together
+         * into one 4-index operator, which is applied to `Psi` only when it is needed,
+         * e.g. before the cursor moves.
+         * Runs of gates on the same pair of sites then cost one contraction with `Psi`.
+         */
+        QCircuit& setGateFusion(bool enabled) {
+            if(!enabled) {
+                flushPendingGates();
+            }
+            gate_fusion = enabled;
+
+            return *this; // for method chaining
+        }
+
+        bool getGateFusion() const {
+            return gate_fusion;
+        }
+
+        /**
+         * @brief enables or disables the in-place gate kernels (enabled by default).
+         *
+         * If enabled, gates at the cursor position are applied by updating the storage of `Psi`
+         * with kernels specialized for diagonal, permutation-like and dense matrices (see `gate_kernels`),
+         * instead of contracting the tensor operator with `Psi`.
+         * Gate fusion (see `setGateFusion()`) takes precedence over the kernels.
+         */
+        QCircuit& setGateKernels(bool enabled) {
+            use_gate_kernels = enabled;
+
+            return *this; // for method chaining
+        }
+
+        bool getGateKernels() const {
+            return use_gate_kernels;
+        }
+
+        /**
+         * @brief writes the whole state of the circuit to `os` in a binary format.
+         *
+         * The topology, the physical and link indices (with their IDs), the site tensors,
+         * the singular values, `Psi` with the pending fused operator, the cursor, the layout, the options
+         * and the state of the random engine are written,
+         * so that the circuit restored by `load()` continues exactly as this one would.
+         * The gate cache is not written.
+         */
+        void save(std::ostream& os) const {
+            binary_io::writeHeader(os, "QCIRCUIT", 2);
+            topology.write(os);
+            for(auto&& index : s) {
+                itensor::write(os, index);
+            }
+            for(auto&& tensor : M) {
+                itensor::write(os, tensor);
+            }
+            for(auto&& tensor : SV) {
+                itensor::write(os, tensor);
+            }
+            itensor::write(os, Psi);
+            binary_io::writeValue<std::uint8_t>(os, static_cast<bool>(pending_op));
+            if(pending_op) {
+                itensor::write(os, pending_op);
+            }
+            binary_io::writeSize(os, cursor.first);
+            binary_io::writeSize(os, cursor.second);
+            binary_io::writeValue<std::uint8_t>(os, psi_dirty);
+            binary_io::writeValue<std::uint8_t>(os, gate_fusion);
+            for(auto site : layout) {
+                binary_io::writeSize(os, site);
+            }
+
+            /* Options. Unset ones stay unset after loading. */
+            binary_io::writeValue<std::uint8_t>(os, default_args.defined("Cutoff"));
+            binary_io::writeValue<double>(os, getCutoff());
+            binary_io::writeValue<std::uint8_t>(os, default_args.defined("MaxDim"));
+            binary_io::writeValue<std::int64_t>(os, getMaxDim());
+            binary_io::writeString(os, getDecomposition());
+            binary_io::writeSize(os, memory_budget);
+            binary_io::writeSize(os, getGateCacheCapacity());
+
+            binary_io::writeValue<double>(os, last_truncation_error);
+            for(auto error : truncation_errors) {
+                binary_io::writeValue<double>(os, error);
+            }
+
+            std::stringstream engine_state;
+            engine_state << random_engine;
+            binary_io::writeString(os, engine_state.str());
+        }
+
+        /** @brief writes the circuit to the file `filename` (see `save(std::ostream&)`). */
+        void save(const std::string& filename) const {
+            std::ofstream ofs(filename, std::ios::binary);
+            if(!ofs) {
+                throw QCircuitException("Cannot open " + filename);
+            }
+            save(ofs);
+        }
+
+        /**
+         * @brief restores a circuit written by `save()`.
+         *
+         * Circuits restored from the same checkpoint share nothing but the indices,
+         * so a common prefix of a circuit can be simulated once and branched from the checkpoint.
+         */
+        static QCircuit load(std::istream& is) {
+            binary_io::readHeader(is, "QCIRCUIT", 2);
+            auto topology = std::make_shared<const CircuitTopology>(CircuitTopology::read(is));
+
+            std::vector<Index> indices(topology->numberOfBits());
+            for(auto&& index : indices) {
+                itensor::read(is, index);
+            }
+
+            QCircuit ret(topology, indices);
+            for(auto&& tensor : ret.M) {
+                itensor::read(is, tensor);
+            }
+            for(auto&& tensor : ret.SV) {
+                itensor::read(is, tensor);
+            }
+            itensor::read(is, ret.Psi);
+            if(binary_io::readValue<std::uint8_t>(is)) {
+                itensor::read(is, ret.pending_op);
+            }
+            ret.cursor.first = binary_io::readSize(is);
+            ret.cursor.second = binary_io::readSize(is);
+            ret.psi_dirty = binary_io::readValue<std::uint8_t>(is);
+            ret.gate_fusion = binary_io::readValue<std::uint8_t>(is);
+            for(size_t qubit = 0;qubit < ret.layout.size();qubit++) {
+                ret.layout[qubit] = binary_io::readSize(is);
+                if(ret.layout[qubit] >= ret.layout.size()) {
+                    throw QCircuitException("Invalid checkpoint : Site out of range");
+                }
+                ret.qubit_at[ret.layout[qubit]] = qubit;
+            }
+
+            bool has_cutoff = binary_io::readValue<std::uint8_t>(is);
+            double cutoff = binary_io::readValue<double>(is);
+            if(has_cutoff) {
+                ret.setCutoff(cutoff);
+            }
+            bool has_max_dim = binary_io::readValue<std::uint8_t>(is);
+            auto max_dim = binary_io::readValue<std::int64_t>(is);
+            if(has_max_dim) {
+                ret.setMaxDim(static_cast<int>(max_dim));
+            }
+            ret.setDecomposition(binary_io::readString(is));
+            ret.setMemoryBudget(binary_io::readSize(is));
+            ret.setGateCacheCapacity(binary_io::readSize(is));
+
+            ret.last_truncation_error = binary_io::readValue<double>(is);
+            for(auto&& error : ret.truncation_errors) {
+                error = binary_io::readValue<double>(is);
+            }
+
+            std::stringstream engine_state(binary_io::readString(is));
+            engine_state >> ret.random_engine;
+
+            if(!is) {
+                throw QCircuitException("Invalid checkpoint : Unexpected end of stream");
+            }
+
+            for(size_t i = 0;i < ret.M.size();i++) {
+                ret.site_bytes[i] = siteTensorBytes(ret.M[i]);
+            }
+            for(size_t link = 0;link < ret.SV.size();link++) {
+                ret.link_bytes[link] = ret.bondDimension(link)*sizeof(Real);
+                ret.workspace.update(link, ret.SV[link]);
+            }
+
+            return ret;
+        }
+
+        /** @brief restores a circuit from the file `filename` (see `load(std::istream&)`). */
+        static QCircuit load(const std::string& filename) {
+            std::ifstream ifs(filename, std::ios::binary);
+            if(!ifs) {
+                throw QCircuitException("Cannot open " + filename);
+            }
+            return load(ifs);
         }
 
         void primeAll() {
+            flushPendingGates();
+
             for(auto& elem : this->s){
                 elem = prime(elem);
             }
@@ -584,10 +1815,19 @@ namespace qcircuit {
             Psi = prime(Psi);
         }
 
+        const ContractionPlan& getContractionPlan() const {
+            return *this->contraction_plan;
+        }
+
         const CircuitTopology& getTopology() const {
             return this->topology;
         }
 
+        /** @brief returns the finalized topology, which can be passed to the constructor of replica circuits. */
+        const std::shared_ptr<const CircuitTopology>& getSharedTopology() const {
+            return this->shared_topology;
+        }
+
         const ITensor& Mref(size_t i) const {
             assert(0 <= i && i < this->size());
             return this->M[i];
@@ -602,6 +1842,15 @@ namespace qcircuit {
             return this->SV[i];
         }
 
+        /** @brief returns the singular values at `link` in descending order. */
+        std::vector<Real> singularValuesAt(size_t link) const {
+            assert(link < this->topology.numberOfLinks());
+            std::vector<Real> ret;
+            SV[link].visit([&ret](Real x) { ret.push_back(x); }); // only diagonal elements are stored
+            return ret;
+        }
+
+        /** @brief returns `Psi`, which does not include the pending fused operator (see `setGateFusion()`). */
         const ITensor& Psiref() const {
             return this->Psi;
         }
@@ -633,31 +1882,35 @@ namespace qcircuit {
     };
 
     /* Prototype declaration of this function is placed at the top. */
-    inline Cplx overlap(QCircuit circuit1,
+    /**
+     * @brief returns <circuit1|op|circuit2>, where `op` holds one-site operators of all the sites.
+     *
+     * Both circuits are left untouched: the site tensors and `Psi` are contracted as they are
+     * (see `QCircuit::networkTensors()`), and the ket layer is primed at contraction time.
+     * The result is normalized by the norms of `Psi` of both circuits,
+     * as the site tensors are kept in the gauge where the norm of the state is that of `Psi`.
+     * The circuits must share the physical indices.
+     * `args` is not used since no decomposition is performed.
+     */
+    inline Cplx overlap(const QCircuit& circuit1,
                         const std::vector<ITensor>& op,
-                        QCircuit circuit2,
-                        const Args& args) {
+                        const QCircuit& circuit2,
+                        [[maybe_unused]] const Args& args) {
         assert(op.size() == circuit1.size() && op.size() == circuit2.size());
 
-        auto topology = circuit1.getTopology();
-
-        circuit1.decomposePsi(args);
-        circuit2.decomposePsi(args);
-
-        circuit2.primeAll();
+        const auto bra = circuit1.networkTensors();
+        const auto ket = circuit2.networkTensors();
 
-        ITensor ret_t(1.0); // Rank zero tensor with amplitude 1.0
-        for(size_t i = 0; i < circuit1.size(); i++) {
-            //reduction
-            ret_t = dag(circuit1.Mref(i))*op[i]*ret_t*circuit2.Mref(i);
-            for(auto&& neighbor : topology.neighborsOf(i)) {
-                if(i < neighbor.site) {
-                    ret_t = dag(circuit1.SVref(neighbor.link))*ret_t*circuit2.SVref(neighbor.link);
-                }
-            }
+        /* Double-layer tensor of each site */
+        const long size = static_cast<long>(circuit1.size());
+        std::vector<ITensor> leaves(size);
+#pragma omp parallel for schedule(dynamic)
+        for(long i = 0; i < size; i++) {
+            leaves[i] = dag(bra[i])*op[i]*prime(ket[i]);
         }
 
-        return ret_t.cplx();
+        auto ret = circuit1.getContractionPlan().contract(std::move(leaves)).cplx();
+        return ret / (norm(bra[circuit1.getCursor().first]) * norm(ket[circuit2.getCursor().first]));
     }
 
 } // namespace qcircuit
@@ -2,11 +2,29 @@
 
 #pragma once
 #include <complex>
+#include <array>
+#include <typeindex>
 #include <itensor/all.h>
 
 namespace qcircuit {
     using namespace itensor;
 
+    /**
+     * @brief Identifier of a gate instance, i.e. gate type, sites and parameters.
+     *
+     * Two gates with the same key produce the same tensor operator,
+     * so this is used as the key of `GateCache`.
+     */
+    struct GateKey {
+        std::type_index type;              //!< @brief Gate type.
+        std::array<size_t, 2> sites;       //!< @brief Sites. Both are the same for one-site gates.
+        std::array<double, 3> parameters;  //!< @brief Real parameters. Unused ones are zero.
+
+        bool operator==(const GateKey& other) const {
+            return type == other.type && sites == other.sites && parameters == other.parameters;
+        }
+    };
+
     /**
      * @brief Abstract class to represent a quantum gate.
      */
@@ -18,6 +36,31 @@ namespace qcircuit {
          * @brief returns corresponding tensor operator.
          */
         virtual ITensor op(const std::vector<Index>& slist) const = 0;
+
+        /**
+         * @brief returns the identifier of this gate.
+         */
+        virtual GateKey key() const = 0;
+
+        /**
+         * @brief returns whether this gate is unitary.
+         *
+         * Non-unitary gates (e.g. projections) change the norm of the wave function.
+         */
+        virtual bool isUnitary() const {
+            return true;
+        }
+
+    protected:
+        /** @brief sets `value` at the given index values, keeping real storage for real values. */
+        template<typename... IndexVals>
+        static void setElement(ITensor& ret, Cplx value, IndexVals&&... index_vals) {
+            if(value.imag() == 0.0) {
+                ret.set(std::forward<IndexVals>(index_vals)..., value.real());
+            } else {
+                ret.set(std::forward<IndexVals>(index_vals)..., value);
+            }
+        }
     };
 
     /**
@@ -27,10 +70,43 @@ namespace qcircuit {
      */
     class OneSiteGate : public Gate {
     public:
+        /**
+         * @brief 2x2 matrix in row-major order, i.e. `matrix[2*i + j]` = <i|U|j>.
+         */
+        using Matrix = std::array<Cplx, 4>;
+
         const size_t site; //!< @brief Site (physical index) ID
 
         OneSiteGate(size_t site) : site(site) {}
         virtual ~OneSiteGate() {}
+
+        /**
+         * @brief returns the matrix representation of this gate.
+         */
+        virtual Matrix matrix() const = 0;
+
+        /**
+         * @brief returns corresponding tensor operator, built from `matrix()`.
+         *
+         * The unprimed index is the output and the primed one is the input.
+         */
+        ITensor op(const std::vector<Index>& slist) const override {
+            auto s = slist[site];
+            auto u = matrix();
+            ITensor ret(s, prime(s));
+            for(int i = 0;i < 2;i++) {
+                for(int j = 0;j < 2;j++) {
+                    if(u[2*i + j] != 0.0) {
+                        setElement(ret, u[2*i + j], s=i+1, prime(s)=j+1);
+                    }
+                }
+            }
+            return ret;
+        }
+
+        GateKey key() const override {
+            return GateKey{typeid(*this), {site, site}, {0.0, 0.0, 0.0}};
+        }
     };
 
     /**
@@ -40,12 +116,9 @@ namespace qcircuit {
     public:
         Id(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=1, prime(s)=1, 1);
-            ret.set(s=2, prime(s)=2, 1);
-            return ret;
+        Matrix matrix() const override {
+            return {1.0, 0.0,
+                    0.0, 1.0};
         }
     };
 
@@ -56,12 +129,9 @@ namespace qcircuit {
     public:
         X(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=1, prime(s)=2, 1);
-            ret.set(s=2, prime(s)=1, 1);
-            return ret;
+        Matrix matrix() const override {
+            return {0.0, 1.0,
+                    1.0, 0.0};
         }
     };
 
@@ -72,12 +142,9 @@ namespace qcircuit {
     public:
         Y(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=1, prime(s)=2, -1_i);
-            ret.set(s=2, prime(s)=1, 1_i);
-            return ret;
+        Matrix matrix() const override {
+            return {0.0, -1_i,
+                    1_i, 0.0};
         }
     };
 
@@ -88,12 +155,9 @@ namespace qcircuit {
     public:
         Z(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=1, prime(s)=1, 1);
-            ret.set(s=2, prime(s)=2, -1);
-            return ret;
+        Matrix matrix() const override {
+            return {1.0, 0.0,
+                    0.0, -1.0};
         }
     };
 
@@ -104,11 +168,13 @@ namespace qcircuit {
     public:
         Proj_0(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=1, prime(s)=1, 1);
-            return ret;
+        Matrix matrix() const override {
+            return {1.0, 0.0,
+                    0.0, 0.0};
+        }
+
+        bool isUnitary() const override {
+            return false;
         }
     };
 
@@ -119,11 +185,13 @@ namespace qcircuit {
     public:
         Proj_1(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=2, prime(s)=2, 1);
-            return ret;
+        Matrix matrix() const override {
+            return {0.0, 0.0,
+                    0.0, 1.0};
+        }
+
+        bool isUnitary() const override {
+            return false;
         }
     };
 
@@ -134,11 +202,13 @@ namespace qcircuit {
     public:
         Proj_0_to_1(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=2, prime(s)=1, 1);
-            return ret;
+        Matrix matrix() const override {
+            return {0.0, 0.0,
+                    1.0, 0.0};
+        }
+
+        bool isUnitary() const override {
+            return false;
         }
     };
 
@@ -149,11 +219,13 @@ namespace qcircuit {
     public:
         Proj_1_to_0(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=1, prime(s)=2, 1);
-            return ret;
+        Matrix matrix() const override {
+            return {0.0, 1.0,
+                    0.0, 0.0};
+        }
+
+        bool isUnitary() const override {
+            return false;
         }
     };
 
@@ -164,9 +236,10 @@ namespace qcircuit {
     public:
         H(size_t site) : OneSiteGate(site) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            return (1.0/sqrt(2.0))*(Proj_0(site).op(slist) + Proj_0_to_1(site).op(slist))
-                 + (1.0/sqrt(2.0))*(Proj_1_to_0(site).op(slist) - Proj_1(site).op(slist));
+        Matrix matrix() const override {
+            const double h = 1.0/std::sqrt(2.0);
+            return {h, h,
+                    h, -h};
         }
     };
 
@@ -179,12 +252,13 @@ namespace qcircuit {
 
         P(size_t site, double theta) : OneSiteGate(site), theta(theta) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s = slist[site];
-            ITensor ret(s, prime(s));
-            ret.set(s=1, prime(s)=1, 1);
-            ret.set(s=2, prime(s)=2, std::exp(1_i * theta));
-            return ret;
+        Matrix matrix() const override {
+            return {1.0, 0.0,
+                    0.0, std::exp(1_i * theta)};
+        }
+
+        GateKey key() const override {
+            return GateKey{typeid(*this), {site, site}, {theta, 0.0, 0.0}};
         }
     };
 
@@ -206,18 +280,16 @@ namespace qcircuit {
                        double theta, double phi, double lambda) :
        OneSiteGate(site), theta(theta), phi(phi), lambda(lambda) {}
 
-      ITensor op(const std::vector<Index>& slist) const override {
+      Matrix matrix() const override {
           std::complex<double> alpha = std::exp(-1_i*(phi+lambda)/2)*cos(theta/2);
           std::complex<double> beta = -std::exp(-1_i*(phi-lambda)/2)*sin(theta/2);
 
-          auto s = slist[site];
-          ITensor ret(s, prime(s));
-          ret.set(s=1, prime(s)=1, alpha);
-          ret.set(s=1, prime(s)=2, beta);
-          ret.set(s=2, prime(s)=1, -std::conj(beta));
-          ret.set(s=2, prime(s)=2, std::conj(alpha));
+          return {alpha, beta,
+                  -std::conj(beta), std::conj(alpha)};
+      }
 
-          return ret;
+      GateKey key() const override {
+          return GateKey{typeid(*this), {site, site}, {theta, phi, lambda}};
       }
     };
 
@@ -229,11 +301,59 @@ namespace qcircuit {
      */
     class TwoSiteGate : public Gate {
     public:
+        /**
+         * @brief 4x4 matrix in row-major order, i.e. `matrix[4*i + j]` = <i|U|j>,
+         * where the basis |i> = |i1 i2> is numbered as `i = 2*i1 + i2` (`i1` is on `site1`).
+         */
+        using Matrix = std::array<Cplx, 16>;
+
         const size_t site1; //!< @brief Site (physical index) ID
         const size_t site2; //!< @brief Site (physical index) ID
 
         TwoSiteGate(size_t site1, size_t site2) : site1(site1), site2(site2) {}
         virtual ~TwoSiteGate() {}
+
+        /**
+         * @brief returns the matrix representation of this gate.
+         */
+        virtual Matrix matrix() const = 0;
+
+        /**
+         * @brief returns corresponding tensor operator, built from `matrix()`.
+         *
+         * The unprimed indices are the outputs and the primed ones are the inputs.
+         */
+        ITensor op(const std::vector<Index>& slist) const override {
+            auto s1 = slist[site1];
+            auto s2 = slist[site2];
+            auto u = matrix();
+            ITensor ret(s1, prime(s1), s2, prime(s2));
+            for(int i = 0;i < 4;i++) {
+                for(int j = 0;j < 4;j++) {
+                    if(u[4*i + j] != 0.0) {
+                        setElement(ret, u[4*i + j],
+                                   s1=i/2+1, prime(s1)=j/2+1, s2=i%2+1, prime(s2)=j%2+1);
+                    }
+                }
+            }
+            return ret;
+        }
+
+        GateKey key() const override {
+            return GateKey{typeid(*this), {site1, site2}, {0.0, 0.0, 0.0}};
+        }
+
+    protected:
+        /**
+         * @brief returns the matrix of the controlled gate |0><0| x I + |1><1| x `u`,
+         * where `site1` is the control.
+         */
+        static Matrix controlled(const OneSiteGate::Matrix& u) {
+            return {1.0, 0.0, 0.0,  0.0,
+                    0.0, 1.0, 0.0,  0.0,
+                    0.0, 0.0, u[0], u[1],
+                    0.0, 0.0, u[2], u[3]};
+        }
     };
 
     /**
@@ -243,9 +363,8 @@ namespace qcircuit {
     public:
         CNOT(size_t site1, size_t site2) : TwoSiteGate(site1, site2) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            return Proj_0(site1).op(slist)*Id(site2).op(slist)
-                + Proj_1(site1).op(slist)*X(site2).op(slist);
+        Matrix matrix() const override {
+            return controlled(X(site2).matrix());
         }
     };
 
@@ -256,9 +375,8 @@ namespace qcircuit {
     public:
         CY(size_t site1, size_t site2) : TwoSiteGate(site1, site2) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            return Proj_0(site1).op(slist)*Id(site2).op(slist)
-                + Proj_1(site1).op(slist)*Y(site2).op(slist);
+        Matrix matrix() const override {
+            return controlled(Y(site2).matrix());
         }
     };
 
@@ -269,9 +387,8 @@ namespace qcircuit {
     public:
         CZ(size_t site1, size_t site2) : TwoSiteGate(site1, site2) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            return Proj_0(site1).op(slist)*Id(site2).op(slist)
-                + Proj_1(site1).op(slist)*Z(site2).op(slist);
+        Matrix matrix() const override {
+            return controlled(Z(site2).matrix());
         }
     };
 
@@ -284,9 +401,12 @@ namespace qcircuit {
 
         CP(size_t site1, size_t site2, double theta) : TwoSiteGate(site1, site2), theta(theta) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            return Proj_0(site1).op(slist)*Id(site2).op(slist)
-                + Proj_1(site1).op(slist)*P(site2, theta).op(slist);
+        Matrix matrix() const override {
+            return controlled(P(site2, theta).matrix());
+        }
+
+        GateKey key() const override {
+            return GateKey{typeid(*this), {site1, site2}, {theta, 0.0, 0.0}};
         }
     };
 
@@ -301,9 +421,12 @@ namespace qcircuit {
 
         CUniversalUnitary(size_t site1, size_t site2, double theta, double phi, double lambda) : TwoSiteGate(site1, site2), theta(theta), phi(phi), lambda(lambda) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            return Proj_0(site1).op(slist)*Id(site2).op(slist)
-                + Proj_1(site1).op(slist)*UniversalUnitary(site2, theta, phi, lambda).op(slist);
+        Matrix matrix() const override {
+            return controlled(UniversalUnitary(site2, theta, phi, lambda).matrix());
+        }
+
+        GateKey key() const override {
+            return GateKey{typeid(*this), {site1, site2}, {theta, phi, lambda}};
         }
     };
 
@@ -314,16 +437,11 @@ namespace qcircuit {
     public:
         Swap(size_t site1, size_t site2) : TwoSiteGate(site1, site2) {}
 
-        ITensor op(const std::vector<Index>& slist) const override {
-            auto s1 = slist[site1];
-            auto s2 = slist[site2];
-            ITensor ret(s1, prime(s1), s2, prime(s2));
-            ret.set(s1=1, prime(s1)=1, s2=1, prime(s2)=1, 1);
-            ret.set(s1=2, prime(s1)=2, s2=2, prime(s2)=2, 1);
-            ret.set(s1=1, prime(s1)=2, s2=2, prime(s2)=1, 1);
-            ret.set(s1=2, prime(s1)=1, s2=1, prime(s2)=2, 1);
-
-            return ret;
+        Matrix matrix() const override {
+            return {1.0, 0.0, 0.0, 0.0,
+                    0.0, 0.0, 1.0, 0.0,
+                    0.0, 1.0, 0.0, 0.0,
+                    0.0, 0.0, 0.0, 1.0};
         }
     };
 }
@@ -0,0 +1,326 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <itensor/all.h>
+#include <vector>
+#include <random>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#include <map>
+#include <numeric>
+#include "pauli_string.hpp"
+#include "qcircuit_exception.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace qcircuit {
+    using namespace itensor;
+
+    /**
+     * @brief Cached partial contractions of the double-layer network <psi|psi>.
+     *
+     * Site tensors are contracted in the order 0, 1, ..., N-1.
+     * `left(k)` holds the contraction of the sites [0, k) and
+     * `right(k)` holds the contraction of the sites [k, N),
+     * so that any one-site quantity is obtained from `left(k) * (site k) * right(k+1)`
+     * without contracting the whole network again.
+     @verbatim
+          left(k)        site k        right(k+1)
+        +---------+     +-----+     +------------+
+        |  dag(T) |-----|dag T|-----|   dag(T)   |
+        |    |    |     |  op |     |     |      |
+        |    T'   |-----|  T' |-----|     T'     |
+        +---------+     +-----+     +------------+
+     @endverbatim
+     *
+     * The ket layer is primed at contraction time, so given site tensors are never modified.
+     * Each site tensor must already include the singular-value tensors of its links
+     * (see `QCircuit::contractionTensors()`).
+     */
+    class SweepEnvironment {
+    private:
+        std::vector<Index> s;   //!< @brief Physical (on-site) indices.
+        std::vector<ITensor> T; //!< @brief Site tensors with singular values absorbed.
+        std::vector<ITensor> L; //!< @brief L[k] is the contraction of sites [0, k).
+        std::vector<ITensor> R; //!< @brief R[k] is the contraction of sites [k, N).
+
+    public:
+        /**
+         * @brief builds left and right environments from contraction-ready site tensors.
+         *
+         * @param physical_indices Physical (on-site) indices.
+         * @param site_tensors Site tensors including singular values of their links.
+         */
+        SweepEnvironment(const std::vector<Index>& physical_indices,
+                         const std::vector<ITensor>& site_tensors) :
+            s(physical_indices), T(site_tensors) {
+            assert(s.size() == T.size());
+
+            const size_t size = T.size();
+            L.reserve(size+1);
+            L.emplace_back(1.0); // Rank zero tensor with amplitude 1.0
+            for(size_t i = 0;i < size;i++) {
+                L.push_back(absorb(L.back(), T[i], s[i]));
+            }
+
+            R.resize(size+1);
+            R[size] = ITensor(1.0);
+            for(size_t i = size;i > 0;i--) {
+                R[i-1] = absorb(R[i], T[i-1], s[i-1]);
+            }
+        }
+
+        /** @brief returns number of sites */
+        size_t size() const {
+            return this->T.size();
+        }
+
+        /** @brief returns the contraction of sites [0, k). */
+        const ITensor& left(size_t k) const {
+            assert(k <= this->size());
+            return this->L[k];
+        }
+
+        /** @brief returns the contraction of sites [k, N). */
+        const ITensor& right(size_t k) const {
+            assert(k <= this->size());
+            return this->R[k];
+        }
+
+        const ITensor& siteTensor(size_t i) const {
+            assert(i < this->size());
+            return this->T[i];
+        }
+
+        const Index& site(size_t i) const {
+            assert(i < this->size());
+            return this->s[i];
+        }
+
+        /** @brief returns <psi|psi>. */
+        Real squaredNorm() const {
+            return std::real(L.back().cplx());
+        }
+
+        /** @brief returns <psi|op|psi> / <psi|psi> for a one-site operator `op` acting on `site`. */
+        Cplx localExpectation(size_t site, const ITensor& op) const {
+            auto ret_t = absorb(L[site], T[site], op)*R[site+1];
+            return ret_t.cplx()/squaredNorm();
+        }
+
+        /**
+         * @brief returns <psi|P|psi> / <psi|psi> of each Pauli string `P` in `terms`, without the coefficients.
+         *
+         * The regions outside the supports are the cached `left()` and `right()`.
+         * The terms are sorted by their factors, so terms sharing leading factors
+         * (e.g. those on the same support) share the contraction of these factors and of the
+         * identity sites between them.
+         * Groups of terms with the same first factor are evaluated in parallel
+         * with `num_threads` threads. 0 means the OpenMP default.
+         */
+        std::vector<Cplx> pauliExpectations(const std::vector<PauliString>& terms, int num_threads = 1) const {
+            using Factor = PauliString::Factor;
+
+            std::map<Factor, ITensor> ops; // built once for each factor
+            for(auto&& term : terms) {
+                if(term.extent() > this->size()) {
+                    throw QCircuitException("Invalid Pauli string : Site out of range");
+                }
+                for(auto&& factor : term.getFactors()) {
+                    if(!ops.count(factor)) {
+                        ops.emplace(factor, PauliString::op(factor.second, factor.first, s));
+                    }
+                }
+            }
+
+            std::vector<size_t> order(terms.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&terms](size_t a, size_t b) {
+                return terms[a].getFactors() < terms[b].getFactors();
+            });
+
+            /* Ranges of `order` with the same first factor */
+            std::vector<std::pair<size_t, size_t>> groups;
+            for(size_t k = 0;k < order.size();k++) {
+                const auto& factors = terms[order[k]].getFactors();
+                if(k == 0 || factors.empty() || terms[order[k-1]].getFactors().empty()
+                   || terms[order[k-1]].getFactors()[0] != factors[0]) {
+                    groups.emplace_back(k, k+1);
+                } else {
+                    groups.back().second = k+1;
+                }
+            }
+
+            std::vector<Cplx> ret(terms.size());
+            const Real norm = squaredNorm();
+            const long count = static_cast<long>(groups.size());
+#ifdef _OPENMP
+            const int threads = (num_threads > 0) ? num_threads : omp_get_max_threads();
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+#endif
+            for(long g = 0;g < count;g++) {
+                /* stack[d] is the contraction of the sites up to the d-th factor of the current term */
+                std::vector<ITensor> stack;
+                const std::vector<Factor>* previous = nullptr;
+                for(size_t k = groups[g].first;k < groups[g].second;k++) {
+                    const auto& factors = terms[order[k]].getFactors();
+                    if(factors.empty()) {
+                        ret[order[k]] = 1.0;
+                        continue;
+                    }
+
+                    size_t common = 0;
+                    while(previous != nullptr && common < std::min(previous->size(), factors.size())
+                          && (*previous)[common] == factors[common]) {
+                        common++;
+                    }
+                    stack.resize(common);
+
+                    for(size_t d = common;d < factors.size();d++) {
+                        const size_t site = factors[d].first;
+                        ITensor env = (d == 0) ? L[site] : stack[d-1];
+                        for(size_t i = (d == 0) ? site : factors[d-1].first + 1;i < site;i++) {
+                            env = absorb(env, T[i], s[i]);
+                        }
+                        stack.push_back(absorb(env, T[site], ops.at(factors[d])));
+                    }
+
+                    ret[order[k]] = (stack.back()*R[factors.back().first + 1]).cplx()/norm;
+                    previous = &factors;
+                }
+            }
+
+            return ret;
+        }
+
+        /**
+         * @brief draws `shots` bitstrings in the computational basis by sequential conditional sampling.
+         *
+         * The k-th qubit is drawn from P(x_k | x_0, ..., x_{k-1}), which is evaluated from
+         * the projected left environment and the cached `right(k+1)`.
+         * Shots are processed as a depth-first walk over the tree of prefixes,
+         * so shots sharing a prefix share its contractions.
+         *
+         * @return Row-major `shots` x `size()` array. The element `[k*size() + i]` is
+         * the value (0 or 1) of the i-th qubit in the k-th shot.
+         */
+        std::vector<std::uint8_t> sample(size_t shots, std::mt19937& engine) const {
+            std::vector<std::uint8_t> ret(shots*this->size());
+            if(shots == 0 || this->size() == 0) {
+                return ret;
+            }
+
+            std::vector<size_t> shot_ids(shots);
+            for(size_t k = 0;k < shots;k++) {
+                shot_ids[k] = k;
+            }
+
+            sampleBranch(0, L[0], shot_ids, engine, ret);
+            return ret;
+        }
+
+        /**
+         * @brief draws one joint outcome of the qubits at `sites` from their marginal distribution.
+         *
+         * As `sample()`, each qubit is drawn from its probability conditioned on the qubits drawn before,
+         * and the other sites are traced out, so this takes O(N) contractions for any number of `sites`.
+         *
+         * @return Outcome (0 or 1) of each site in the order of `sites`.
+         */
+        std::vector<int> sampleSites(const std::vector<size_t>& sites, std::mt19937& engine) const {
+            std::vector<int> ret(sites.size(), 0);
+            if(sites.empty()) {
+                return ret;
+            }
+
+            std::vector<size_t> order(sites.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&sites](size_t a, size_t b) { return sites[a] < sites[b]; });
+
+            ITensor env = L[sites[order[0]]];
+            size_t site = sites[order[0]];
+            for(auto k : order) {
+                for(;site < sites[k];site++) {
+                    env = absorb(env, T[site], s[site]);
+                }
+
+                std::array<ITensor, 2> branch;
+                std::array<double, 2> weight;
+                for(int value = 0;value < 2;value++) {
+                    branch[value] = absorbProjected(env, T[site], s[site], value);
+                    // <psi|P|psi> is real and non-negative by definition, up to truncation errors.
+                    weight[value] = std::max(0.0, std::real((branch[value]*R[site+1]).cplx()));
+                }
+                if(weight[0] + weight[1] <= 0.0) {
+                    weight[0] = 1.0; // Degenerate branch caused by truncation; fall back to |0>.
+                }
+
+                std::uniform_real_distribution<> dist(0.0, weight[0] + weight[1]);
+                ret[k] = (dist(engine) < weight[0]) ? 0 : 1;
+                env = branch[ret[k]];
+                site++;
+            }
+            return ret;
+        }
+
+        /** @brief contracts site tensor `t` into the environment `env` with identity on the physical index `s`. */
+        static ITensor absorb(const ITensor& env, const ITensor& t, const Index& s) {
+            return env*prime(dag(t), s)*prime(t);
+        }
+
+        /** @brief contracts site tensor `t` into the environment `env` with one-site operator `op`. */
+        static ITensor absorb(const ITensor& env, const ITensor& t, const ITensor& op) {
+            return env*dag(t)*op*prime(t);
+        }
+
+        /**
+         * @brief contracts site tensor `t` into the environment `env` with projector |value><value|
+         * on the physical index `s`, where `value` is 0 or 1.
+         */
+        static ITensor absorbProjected(const ITensor& env, const ITensor& t, const Index& s, int value) {
+            assert(value == 0 || value == 1);
+            return env*(dag(t)*setElt(s=value+1))*(prime(t)*setElt(prime(s)=value+1));
+        }
+
+    private:
+        /** @brief samples the qubits from `site` for `shot_ids`, all of which share the prefix contracted in `left`. */
+        void sampleBranch(size_t site, const ITensor& left, const std::vector<size_t>& shot_ids,
+                          std::mt19937& engine, std::vector<std::uint8_t>& result) const {
+            if(site == this->size()) {
+                return;
+            }
+
+            std::array<ITensor, 2> branch;
+            std::array<double, 2> weight;
+            for(int value = 0;value < 2;value++) {
+                branch[value] = absorbProjected(left, T[site], s[site], value);
+                // <psi|P|psi> is real and non-negative by definition, up to truncation errors.
+                weight[value] = std::max(0.0, std::real((branch[value]*R[site+1]).cplx()));
+            }
+
+            if(weight[0] + weight[1] <= 0.0) {
+                weight[0] = 1.0; // Degenerate branch caused by truncation; fall back to |0>.
+            }
+
+            std::array<std::vector<size_t>, 2> next_ids;
+            std::uniform_real_distribution<> dist(0.0, weight[0] + weight[1]);
+            for(auto id : shot_ids) {
+                int value = (dist(engine) < weight[0]) ? 0 : 1;
+                result[id*this->size() + site] = value;
+                next_ids[value].push_back(id);
+            }
+
+            for(int value = 0;value < 2;value++) {
+                if(!next_ids[value].empty()) {
+                    sampleBranch(site+1, branch[value], next_ids[value], engine, result);
+                }
+            }
+        }
+    };
+} // namespace qcircuit
@@ -0,0 +1,106 @@
+//Copyright (c) 2020 Jij Inc.
+
+
+#pragma once
+
+#include <itensor/all.h>
+#include <vector>
+#include <cassert>
+#include "gate_kernels.hpp"
+
+namespace qcircuit {
+    using namespace itensor;
+
+    namespace gate_kernels {
+
+        /** @brief ITensor task multiplying the slice `k` of an index with stride `stride` by `values[k]`. */
+        struct ScaleIndex {
+            const std::vector<Real>& values;
+            size_t stride;
+        };
+
+        template<typename T>
+        void doTask(const ScaleIndex& task, Dense<T>& d) {
+            const size_t stride = task.stride;
+            const size_t dim = task.values.size();
+            const size_t blocks = d.size() / (stride*dim);
+            T* data = d.data();
+            for(size_t r = 0;r < blocks;r++) {
+                for(size_t k = 0;k < dim;k++) {
+                    const Real value = task.values[k];
+                    T* p = data + (r*dim + k)*stride;
+#pragma omp simd
+                    for(size_t l = 0;l < stride;l++) {
+                        p[l] *= value;
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief contracts `T` with the diagonal matrix `values` with indices (`from`, `to`) in place,
+         * i.e. scales the slices of `from` and renames it to `to`.
+         *
+         * `T` must have dense storage. No tensor is allocated unless the storage of `T` is shared.
+         */
+        inline void contractDiagonal(ITensor& T, const Index& from, const Index& to, const std::vector<Real>& values) {
+            assert(dim(from) == static_cast<long>(values.size()));
+            doTask(ScaleIndex{values, strideOf(T, from)}, T.store());
+            T.replaceInds(IndexSet(from), IndexSet(to));
+        }
+    } // namespace gate_kernels
+
+    /**
+     * @brief Singular values of every link as plain arrays, together with their inverses.
+     *
+     * `QCircuit` multiplies site tensors by singular values (and divides them) on every cursor move.
+     * Contracting with the diagonal tensors allocates a new tensor per product,
+     * while `gate_kernels::contractDiagonal()` with these arrays scales the tensors in place.
+     * The arrays are updated only when the singular values of a link change,
+     * and keep their capacity, so the footprint is bounded by the largest bond dimension of each link.
+     */
+    class SingularValueWorkspace {
+    private:
+        std::vector<std::vector<Real>> values;
+        std::vector<std::vector<Real>> inverses;
+
+    public:
+        /**
+         * @brief Singular values below this are treated as zero instead of being inverted,
+         * since their inverses could cause numerical instability.
+         */
+        static constexpr double SINGULAR_VALUE_THRESHOLD = 1e-16;
+
+        explicit SingularValueWorkspace(size_t num_links = 0) : values(num_links), inverses(num_links) {}
+
+        /** @brief copies the diagonal elements of `S`, the singular values of `link`. */
+        void update(size_t link, const ITensor& S) {
+            auto& v = values[link];
+            v.clear(); // keeps the capacity
+            S.visit([&v](Real x) { v.push_back(x); }); // only diagonal elements are stored
+
+            auto& inv = inverses[link];
+            inv.resize(v.size());
+            for(size_t k = 0;k < v.size();k++) {
+                inv[k] = (v[k] < SINGULAR_VALUE_THRESHOLD) ? 0.0 : 1.0/v[k];
+            }
+        }
+
+        const std::vector<Real>& valuesAt(size_t link) const {
+            return values[link];
+        }
+
+        const std::vector<Real>& inversesAt(size_t link) const {
+            return inverses[link];
+        }
+
+        /** @brief returns the allocated size in bytes. */
+        size_t bytes() const {
+            size_t ret = 0;
+            for(size_t link = 0;link < values.size();link++) {
+                ret += (values[link].capacity() + inverses[link].capacity())*sizeof(Real);
+            }
+            return ret;
+        }
+    };
+} // namespace qcircuit
@@ -1,5 +1,6 @@
 import qiskit.qasm
 import qiskit.qasm.node
+import numpy
 from qcircuit.core import *
 from .registers import QuantumRegisters, ClassicalRegisters
 from .exception import QASMError
@@ -17,6 +18,8 @@ class QASMInterpreter:
         _cregs (ClassicalRegisters): The classical register information.
         _custom_unitaries (dict[str, list[qiskit.qasm.node.Node]]): The dictionary which maps
             a function name to its definition.
+        _pending_gates (list[tuple]): The gates not yet submitted to the engine,
+            in the field order of `GATE_SPEC_DTYPE`.
     """
 
     def __init__(self, data, topology = make_chain(50)):
@@ -37,6 +40,7 @@ class QASMInterpreter:
         self._qregs = QuantumRegisters(self._max_qubit)
         self._cregs = ClassicalRegisters()
         self._custom_unitaries = {}
+        self._pending_gates = []
 
     def execute(self):
         """
@@ -54,6 +58,8 @@ class QASMInterpreter:
         for stat in statements:
             self._execute_statement(stat, {})
 
+        self._flush_gates()
+
     def _execute_statement(self, stat, env):
         """
         Executes a single statement inside given variable environment.
@@ -142,6 +148,41 @@ class QASMInterpreter:
             # Qiskit parser also raises the error
             # wtih multiple definition
 
+    def _push_gate(self, opcode, site1, site2=0, theta=0.0, phi=0.0, lamda=0.0):
+        """
+        Buffers a gate to be applied by the next `_flush_gates()`.
+
+        Args:
+            opcode (GateOpcode): The gate type.
+            site1 (int): The virtual qubit-index of one-site gates, or the first one of two-site gates.
+            site2 (int): The second virtual qubit-index of two-site gates.
+            theta, phi, lamda (float): The gate parameters.
+        """
+
+        self._pending_gates.append((int(opcode), site1, site2,
+                                    float(theta), float(phi), float(lamda)))
+
+    def _flush_gates(self):
+        """
+        Applies all the buffered gates to the engine in one call.
+
+        The engine maps the virtual indices (logical qubits) to hardware indices,
+        and moves qubits next to each other for two-site gates on distant qubits.
+        """
+
+        if self._pending_gates:
+            specs = numpy.array(self._pending_gates, dtype=GATE_SPEC_DTYPE)
+            self._pending_gates = []
+            self._engine.apply_all_logical(specs)
+
+    def _hardware_index(self, id, index):
+        """
+        Returns the current hardware index of the given quantum register,
+        which is valid after `_flush_gates()`.
+        """
+
+        return self._engine.site_of(self._qregs.get_virtual_index(id, index))
+
     def _measure(self, args):
         """
         Measures qubit(s) and stores the result into a classical register.
@@ -153,10 +194,13 @@ class QASMInterpreter:
         Raises:
             QASMError: Specifying invalid combination of quantum and classical registers.
         """
+
+        self._flush_gates()
+
         if (type(args[0]) == qiskit.qasm.node.IndexedId and
                 type(args[1]) == qiskit.qasm.node.IndexedId):
-            qubit_index = self._qregs.get_hardware_index(args[0].name, args[0].index)
-            observed = self._engine.observe_qubit(qubit_index)
+            qubit_index = self._hardware_index(args[0].name, args[0].index)
+            observed = self._engine.measure([qubit_index])[0]
             self._cregs.set(args[1].name, args[1].index, observed)
         elif (type(args[0]) == qiskit.qasm.node.Id and
                 type(args[1]) == qiskit.qasm.node.Id):
@@ -165,10 +209,10 @@ class QASMInterpreter:
                 raise QASMError('measure', message)
 
             size = self._qregs.get_size(args[0].name)
+            qubit_indices = [self._hardware_index(args[0].name, i) for i in range(size)]
+            observed = self._engine.measure(qubit_indices)
             for i in range(size):
-                qubit_index = self._qregs.get_hardware_index(args[0].name, i)
-                observed = self._engine.observe_qubit(qubit_index)
-                self._cregs.set(args[1].name, i, observed)
+                self._cregs.set(args[1].name, i, observed[i])
         else:
             raise QASMError('measure', 'Unsupported argument type')
 
@@ -181,18 +225,19 @@ class QASMInterpreter:
 
         Note:
            The OpenQASM 2.0 specification requires the reset operation to generates a mixed state.
-           However, the spec can't be implemented due to an engine limitation.
-           Thus the current version of this method just makes projection onto |0>.
+           Each run is one trajectory of it: the qubits are measured and flipped back to |0>
+           if the outcome is 1, so the entangled qubits are left as the measurement does.
         """
 
+        self._flush_gates()
+
         if type(args[0]) == qiskit.qasm.node.IndexedId:
-            qubit_index = self._qregs.get_hardware_index(args[0].name, args[0].index)
-            self._engine.reset_qubit(args[0].name)
+            qubit_index = self._hardware_index(args[0].name, args[0].index)
+            self._engine.reset_qubit(qubit_index)
         else:
             size = self._qregs.get_size(args[0].name)
-            for i in range(size):
-                qubit_index = self._qregs.get_hardware_index(args[0].name, i)
-                self._engine.reset_qubit(qubit_index)
+            qubit_indices = [self._hardware_index(args[0].name, i) for i in range(size)]
+            self._engine.reset_qubits(qubit_indices)
 
     def _call_universal_unitary(self, args, env):
         """
@@ -220,13 +265,13 @@ class QASMInterpreter:
             qreg = env[args[1].name]  # resolve symbol in the current scope
 
         if type(qreg) == qiskit.qasm.node.IndexedId:
-            qubit_index = self._qregs.get_hardware_index(qreg.name, qreg.index)
-            self._engine.apply(UniversalUnitary(qubit_index, theta, phi, lamda))
+            qubit_index = self._qregs.get_virtual_index(qreg.name, qreg.index)
+            self._push_gate(GateOpcode.UniversalUnitary, qubit_index, 0, theta, phi, lamda)
         elif type(qreg) == qiskit.qasm.node.Id:
             size = self._qregs.get_size(qreg.name)
             for i in range(size):
-                qubit_index = self._qregs.get_hardware_index(qreg.name, i)
-                self._engine.apply(UniversalUnitary(qubit_index, theta, phi, lamda))
+                qubit_index = self._qregs.get_virtual_index(qreg.name, i)
+                self._push_gate(GateOpcode.UniversalUnitary, qubit_index, 0, theta, phi, lamda)
 
     def _call_cnot(self, args, env):
         """
@@ -271,16 +316,9 @@ class QASMInterpreter:
             qubit_v_indices0 = [self._qregs.get_virtual_index(qreg0.name, i) for i in range(size)]
             qubit_v_indices1 = [self._qregs.get_virtual_index(qreg1.name, i) for i in range(size)]
 
+        # The engine moves the target next to the control if they are not neighbors.
         for vi0, vi1 in zip(qubit_v_indices0, qubit_v_indices1):
-            hi0 = self._qregs.convert_to_hardware_index(vi0)
-            hi1 = self._qregs.convert_to_hardware_index(vi1)
-
-            self._move_qubit_to_neighbor(hi0, hi1)
-
-            new_hi0 = self._qregs.convert_to_hardware_index(vi0)
-            new_hi1 = self._qregs.convert_to_hardware_index(vi1)
-
-            self._engine.apply(CNOT(new_hi0, new_hi1))
+            self._push_gate(GateOpcode.CNOT, vi0, vi1)
 
     def _call_custom_unitary(self, args, env):
         """
@@ -349,22 +387,3 @@ class QASMInterpreter:
 
         if self._cregs.get_data(id) == value:
             self._execute_statement(args[2], env)
-
-    def _move_qubit_to_neighbor(self, hardware_origin, hardware_target):
-        """
-        Moves a qubit to a neighboring site of another qubit.
-
-        The move is achieved by sequential swapping of two neighboring qubits.
-
-        Args:
-            hardware_origin (int): The hardware qubit-index that one of its neighboring site
-                will be replaced by `hardware_target`.
-            hardware_target (int): The hardware qubit-index to be moved.
-        """
-
-        swap_list = self._engine.get_swap_path(hardware_origin, hardware_target)
-
-        for i in range(len(swap_list)-1):
-            self._engine.apply(Swap(swap_list[i], swap_list[i+1]))
-
-        self._qregs.update_qubit_position(swap_list)
@@ -8,8 +8,8 @@ class QuantumRegisters:
     e.g. if one declares "qreg q[3];" and then "qreg r[4];", the quantum register "q"
     uses the virtual index from 0 to 2 and the "r" uses from 3 to 6.
     As well as this example, the virtual indices are consumed in ascending order.
-    A virtual index corresponds to a hardware index at a certain moment,
-    but the correspondence changes dynamically.
+    The virtual indices are the logical qubits of the engine (`QCircuit`),
+    which keeps their correspondence to the hardware indices (`QCircuit.site_of`).
 
     Attributes:
         _top (int): The minimum index not being used, e.g. in the above example
@@ -17,7 +17,6 @@ class QuantumRegisters:
         _qubit_num(int): The number of hardware qubits.
         _qregs (dict[str, QuantumRegisters.RegInfo]): The dictionary to convert a quantum register name
             to its info.
-        _index_map_virtual_to_hardware (list[int]): The list which maps a virtual index to a hardware index.
     """
 
     def __init__(self, qubit_num):
@@ -32,7 +31,6 @@ class QuantumRegisters:
         self._top = 0
         self._qubit_num = qubit_num
         self._qregs = {}
-        self._index_map_virtual_to_hardware = [i for i in range(qubit_num)]
 
     def add(self, id, size):
         """
@@ -76,45 +74,11 @@ class QuantumRegisters:
         """
 
         if index >= self._qregs[id].get_size():
-            raise QASMError('get_hardware_index',
+            raise QASMError('get_virtual_index',
                             'Index exceeds register size')
 
         return self._qregs[id].get_start_index() + index
 
-    def get_hardware_index(self, id, index):
-        """
-        Returns the hardware index corresponding to the given quantum register.
-
-        More about the hardware index, see the class documentation.
-
-        Args:
-            id (str): The name of the register.
-            index (int): The index of the register.
-
-        Returns:
-            int: The hardware index.
-
-        Raises:
-            QASMError: The index exceeds the size of the register.
-        """
-
-        return self._index_map_virtual_to_hardware[self.get_virtual_index(id, index)]
-
-    def convert_to_hardware_index(self, virtual_index):
-        """
-        Returns the hardware index corresponding to the given virtual index.
-
-        More about the virtual/hardware index, see the class documentation.
-
-        Args:
-            virtual_index (int): The virtual index.
-
-        Returns:
-            int: The hardware index.
-        """
-
-        return self._index_map_virtual_to_hardware[virtual_index]
-
     def get_size(self, id):
         """
         Returns the size of the quantum register.
@@ -128,36 +92,6 @@ class QuantumRegisters:
 
         return self._qregs[id].get_size()
 
-    def update_qubit_position(self, swap_list):
-        """
-        Updates qubit position by swapping qubits.
-
-        This method change the correspondence between the virtual indices and
-        the hardware indices, swapping ith and (i+1)th hardware index from left to right.
-        As an example, if that the initial correspondence map
-        (`_index_map_virtual_to_hardware`) is [0 1 2 3 4] and [4, 3, 1, 0] is given as an argument,
-        The process is as follows
-
-        1. Swaps 4 and 3, thus the correspondence map becomes [0 1 2 4 3]
-        2. Swaps 3 and 1, thus the correspondence map becomes [0 3 2 4 1]
-        3. Swaps 1 and 0, thus the correspondence map becomes [1 3 2 4 0]
-
-        Args:
-            swap_list (list[int]): The list of hardware indices.
-
-        Returns:
-            int: The register size.
-        """
-
-        for i in range(len(swap_list)-1):
-            virtual_index0 = self._index_map_virtual_to_hardware.index(swap_list[i])
-            virtual_index1 = self._index_map_virtual_to_hardware.index(swap_list[i+1])
-
-            # swap items
-            tmp = self._index_map_virtual_to_hardware[virtual_index0]
-            self._index_map_virtual_to_hardware[virtual_index0] = self._index_map_virtual_to_hardware[virtual_index1]
-            self._index_map_virtual_to_hardware[virtual_index1] = tmp
-
     def __contains__(self, item):
         return item in self._qregs
 
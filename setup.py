@@ -104,9 +104,15 @@ class BuildExt(build_ext):
             opts.append(cpp_flag(self.compiler))
             if has_flag(self.compiler, '-fvisibility=hidden'):
                 opts.append('-fvisibility=hidden')
+            if has_flag(self.compiler, '-fopenmp'):
+                opts.append('-fopenmp')
+                link_opts.append('-fopenmp')
 
         for ext in self.extensions:
             ext.define_macros = [('VERSION_INFO', '"{}"'.format(self.distribution.get_version()))]
+            if os.environ.get('QCIRCUIT_STATS'):
+                # record counters of circuits (see CircuitStats)
+                ext.define_macros.append(('QCIRCUIT_STATS', None))
             ext.extra_compile_args = opts
             ext.extra_link_args = link_opts
         build_ext.build_extensions(self)
@@ -126,6 +132,7 @@ setup(
     packages=find_packages(),
     install_requires=[
           'qiskit',
+          'numpy',
     ],
     zip_safe=False,
 )
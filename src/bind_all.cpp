@@ -7,11 +7,23 @@ namespace qcircuit {
     void init_circuit_topology(py::module&);
     void init_circuits(py::module&);
     void init_quantum_gate(py::module&);
+    void init_cursor_scheduler(py::module&);
+    void init_gate_spec(py::module&);
+    void init_circuit_pool(py::module&);
+    void init_qasm_program(py::module&);
+    void init_pauli_string(py::module&);
+    void init_circuit_prototype(py::module&);
 
     PYBIND11_MODULE(_core, m) {
         init_qcircuit(m);
         init_circuit_topology(m);
         init_circuits(m);
         init_quantum_gate(m);
+        init_cursor_scheduler(m);
+        init_gate_spec(m);
+        init_circuit_pool(m);
+        init_qasm_program(m);
+        init_pauli_string(m);
+        init_circuit_prototype(m);
     }
 }
@@ -0,0 +1,35 @@
+#include <vector>
+#include <circuit_pool.hpp>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+
+namespace qcircuit {
+    namespace py = pybind11;
+
+    void init_circuit_pool(py::module& m) {
+        py::class_<CircuitPool>(m, "CircuitPool")
+            .def(py::init<const std::vector<QCircuit>&>())
+            .def(py::init<const QCircuit&, size_t>())
+            .def("__len__", &CircuitPool::size)
+            .def("__getitem__", [](CircuitPool& pool, size_t index) -> QCircuit& {
+                     if(index >= pool.size()) {
+                         throw py::index_error();
+                     }
+                     return pool[index];
+                 },
+                 py::return_value_policy::reference_internal)
+            .def("set_seed", &CircuitPool::setSeed)
+            .def("apply_all", [](CircuitPool& pool,
+                                 py::array_t<GateSpec, py::array::c_style | py::array::forcecast> specs) {
+                     const GateSpec* data = specs.data();
+                     const size_t count = specs.size();
+                     py::gil_scoped_release release;
+                     pool.applyAll(data, count);
+                 },
+                 py::arg("specs"))
+            .def("marginal_probabilities", &CircuitPool::marginalProbabilities,
+                 py::arg("expected") = 0, py::call_guard<py::gil_scoped_release>())
+            .def_property("num_threads", &CircuitPool::getNumThreads, &CircuitPool::setNumThreads);
+    }
+}
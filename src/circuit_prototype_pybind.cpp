@@ -0,0 +1,23 @@
+#include <optional>
+#include <cstdint>
+#include <circuit_prototype.hpp>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace qcircuit {
+    namespace py = pybind11;
+
+    void init_circuit_prototype(py::module& m) {
+        py::class_<CircuitPrototype>(m, "CircuitPrototype")
+            .def(py::init<const QCircuit&>())
+            .def(py::init([](CircuitTopology& topology) {
+                     topology.finalize(); // see `QCircuit.__init__`
+                     return CircuitPrototype(topology);
+                 }))
+            .def("stamp", [](const CircuitPrototype& prototype, std::optional<std::uint32_t> seed) {
+                     return seed ? prototype.stamp(*seed) : prototype.stamp();
+                 },
+                 py::arg("seed") = py::none())
+            .def("stamp_with_fresh_indices", &CircuitPrototype::stampWithFreshIndices, py::arg("seed"));
+    }
+}
@@ -10,6 +10,8 @@ namespace qcircuit {
             .def("generate_link", &CircuitTopology::generateLink)
             .def("number_of_bits", &CircuitTopology::numberOfBits)
             .def("number_of_links", &CircuitTopology::numberOfLinks)
+            .def("finalize", &CircuitTopology::finalize)
+            .def("is_finalized", &CircuitTopology::isFinalized)
             .def("convert_to_dot_string", &CircuitTopology::convertToDotString,
                  py::arg("layout") = "neato",
                  py::arg("shape") = "circle");
@@ -0,0 +1,25 @@
+#include <cursor_scheduler.hpp>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace qcircuit {
+    namespace py = pybind11;
+
+    void init_cursor_scheduler(py::module& m) {
+        py::class_<CursorScheduler::Report>(m, "ScheduleReport")
+            .def_readonly("shifts_before", &CursorScheduler::Report::shifts_before)
+            .def_readonly("shifts_after", &CursorScheduler::Report::shifts_after)
+            .def_readonly("decompositions_before", &CursorScheduler::Report::decompositions_before)
+            .def_readonly("decompositions_after", &CursorScheduler::Report::decompositions_after);
+
+        py::class_<CursorScheduler>(m, "CursorScheduler")
+            .def(py::init<const CircuitTopology&>(), py::keep_alive<1, 2>())
+            .def("count_shifts", &CursorScheduler::countShifts)
+            .def("count_decompositions", &CursorScheduler::countDecompositions,
+                 py::arg("cursor"), py::arg("gates"), py::arg("dirty") = false)
+            .def("schedule", &CursorScheduler::schedule,
+                 py::arg("cursor"), py::arg("gates"), py::arg("dirty") = false)
+            .def("report", &CursorScheduler::report,
+                 py::arg("cursor"), py::arg("gates"), py::arg("order"), py::arg("dirty") = false);
+    }
+}
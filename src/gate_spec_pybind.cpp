@@ -0,0 +1,32 @@
+#include <gate_spec.hpp>
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+namespace qcircuit {
+    namespace py = pybind11;
+
+    void init_gate_spec(py::module& m) {
+        py::enum_<GateOpcode>(m, "GateOpcode")
+            .value("Id", GateOpcode::Id)
+            .value("X", GateOpcode::X)
+            .value("Y", GateOpcode::Y)
+            .value("Z", GateOpcode::Z)
+            .value("H", GateOpcode::H)
+            .value("P", GateOpcode::P)
+            .value("UniversalUnitary", GateOpcode::UniversalUnitary)
+            .value("Proj_0", GateOpcode::Proj_0)
+            .value("Proj_1", GateOpcode::Proj_1)
+            .value("Proj_0_to_1", GateOpcode::Proj_0_to_1)
+            .value("Proj_1_to_0", GateOpcode::Proj_1_to_0)
+            .value("CNOT", GateOpcode::CNOT)
+            .value("CY", GateOpcode::CY)
+            .value("CZ", GateOpcode::CZ)
+            .value("CP", GateOpcode::CP)
+            .value("CUniversalUnitary", GateOpcode::CUniversalUnitary)
+            .value("Swap", GateOpcode::Swap);
+
+        // Structured dtype with fields (opcode, site1, site2, theta, phi, lambda).
+        PYBIND11_NUMPY_DTYPE(GateSpec, opcode, site1, site2, theta, phi, lambda);
+        m.attr("GATE_SPEC_DTYPE") = py::dtype::of<GateSpec>();
+    }
+}
@@ -0,0 +1,19 @@
+#include <vector>
+#include <string>
+#include <pauli_string.hpp>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/complex.h>
+
+namespace qcircuit {
+    namespace py = pybind11;
+
+    void init_pauli_string(py::module& m) {
+        py::class_<PauliString>(m, "PauliString")
+            .def(py::init<const std::string&, Cplx>(), py::arg("paulis"), py::arg("coefficient") = 1.0)
+            .def(py::init<const std::vector<PauliString::Factor>&, Cplx>(), py::arg("factors"), py::arg("coefficient") = 1.0)
+            .def_property_readonly("factors", &PauliString::getFactors)
+            .def_property_readonly("coefficient", &PauliString::getCoefficient)
+            .def("weight", &PauliString::weight);
+    }
+}
@@ -0,0 +1,24 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <qasm_program.hpp>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace qcircuit {
+    namespace py = pybind11;
+
+    void init_qasm_program(py::module& m) {
+        py::class_<QasmProgram>(m, "QasmProgram")
+            .def_static("parse", &QasmProgram::parse, py::arg("source"), py::arg("topology"))
+            .def("run", &QasmProgram::run, py::arg("circuit"),
+                 py::arg("bindings") = std::map<std::string, double>(),
+                 py::call_guard<py::gil_scoped_release>())
+            .def("register_value", py::overload_cast<const std::vector<int>&, const std::string&>(&QasmProgram::registerValue, py::const_),
+                 py::arg("bits"), py::arg("name"))
+            .def_property_readonly("parameters", &QasmProgram::getParameters)
+            .def("number_of_instructions", [](const QasmProgram& program) { return program.getInstructions().size(); })
+            .def("number_of_qubits", &QasmProgram::numberOfQubits)
+            .def("number_of_classical_bits", &QasmProgram::numberOfClassicalBits);
+    }
+}
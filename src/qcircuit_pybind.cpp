@@ -1,27 +1,166 @@
 #include <vector>
+#include <optional>
+#include <cstdint>
+#include <string>
+#include <sstream>
 #include <itensor/all.h>
 #include <qcircuit.hpp>
 #include <circuit_topology.hpp>
 #include <quantum_gate.hpp>
+#include <gate_spec.hpp>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/complex.h>
+#include <pybind11/numpy.h>
 
 namespace qcircuit {
     namespace py = pybind11;
 
     void init_qcircuit(py::module& m) {
         py::class_<QCircuit>(m, "QCircuit")
-            .def(py::init<const CircuitTopology&>())
-            .def("apply", py::overload_cast<const OneSiteGate&, const OneSiteGate&>(&QCircuit::apply))
-            .def("apply", py::overload_cast<const OneSiteGate&>(&QCircuit::apply))
-            .def("apply", py::overload_cast<const TwoSiteGate&>(&QCircuit::apply))
+            .def(py::init([](CircuitTopology& topology) {
+                     // Finalized in place, so that the next circuits on `topology` reuse its tables and contraction plan.
+                     topology.finalize();
+                     return QCircuit(topology);
+                 }))
+            .def("apply", py::overload_cast<const OneSiteGate&, const OneSiteGate&>(&QCircuit::apply), py::call_guard<py::gil_scoped_release>())
+            .def("apply", py::overload_cast<const OneSiteGate&>(&QCircuit::apply), py::call_guard<py::gil_scoped_release>())
+            .def("apply", py::overload_cast<const TwoSiteGate&>(&QCircuit::apply), py::call_guard<py::gil_scoped_release>())
+            .def("apply_all", [](QCircuit& circuit,
+                                 py::array_t<GateSpec, py::array::c_style | py::array::forcecast> specs) {
+                     // The buffer is read in place; `specs` keeps it alive during the call.
+                     const GateSpec* data = specs.data();
+                     const size_t count = specs.size();
+                     py::gil_scoped_release release;
+                     circuit.applyAll(data, count);
+                 },
+                 py::arg("specs"))
+            .def("apply_all_logical", [](QCircuit& circuit,
+                                         py::array_t<GateSpec, py::array::c_style | py::array::forcecast> specs) {
+                     const GateSpec* data = specs.data();
+                     const size_t count = specs.size();
+                     py::gil_scoped_release release;
+                     circuit.applyAllLogical(data, count);
+                 },
+                 py::arg("specs"))
+            .def("reset", &QCircuit::reset)
+            .def("mark_initial_state", &QCircuit::markInitialState)
+            .def("site_of", &QCircuit::siteOf)
+            .def("qubit_at", &QCircuit::qubitAt)
+            .def_property_readonly("layout", &QCircuit::getLayout)
+            .def("relabel_qubits", &QCircuit::relabelQubits)
+            .def("exchange_sites", py::overload_cast<size_t, size_t>(&QCircuit::exchangeSites), py::call_guard<py::gil_scoped_release>())
+            .def("apply_scheduled", py::overload_cast<const std::vector<const Gate*>&>(&QCircuit::applyScheduled), py::call_guard<py::gil_scoped_release>())
             .def("get_cursor", &QCircuit::getCursor)
-            .def("move_cursor_along", py::overload_cast<const std::vector<size_t>&>(&QCircuit::moveCursorAlong))
-            .def("probability_of_zero", &QCircuit::probabilityOfZero)
-            .def("observe_qubit", py::overload_cast<size_t>(&QCircuit::observeQubit))
-            .def("reset_qubit", py::overload_cast<size_t>(&QCircuit::resetQubit))
+            .def("move_cursor_along", py::overload_cast<const std::vector<size_t>&>(&QCircuit::moveCursorAlong), py::call_guard<py::gil_scoped_release>())
+            .def("probability_of_zero", &QCircuit::probabilityOfZero, py::call_guard<py::gil_scoped_release>())
+            .def("marginal_probabilities", &QCircuit::marginalProbabilities,
+                 py::arg("expected") = 0, py::call_guard<py::gil_scoped_release>())
+            .def("expectation_values", &QCircuit::expectationValues, py::call_guard<py::gil_scoped_release>())
+            .def("pauli_expectations", &QCircuit::pauliExpectations,
+                 py::arg("terms"), py::arg("num_threads") = 1, py::call_guard<py::gil_scoped_release>())
+            .def("expectation", &QCircuit::expectation,
+                 py::arg("terms"), py::arg("num_threads") = 1, py::call_guard<py::gil_scoped_release>())
+            .def("sample", [](QCircuit& circuit, size_t shots, std::optional<std::uint32_t> seed) {
+                     std::vector<std::uint8_t> bits;
+                     {
+                         py::gil_scoped_release release;
+                         bits = seed ? circuit.sample(shots, *seed) : circuit.sample(shots);
+                     }
+                     std::vector<py::ssize_t> shape{static_cast<py::ssize_t>(shots),
+                                                    static_cast<py::ssize_t>(circuit.size())};
+                     py::array_t<std::uint8_t> ret(shape);
+                     std::copy(bits.begin(), bits.end(), ret.mutable_data());
+                     return ret;
+                 },
+                 py::arg("shots"),
+                 py::arg("seed") = py::none())
+            .def("observe_qubit", py::overload_cast<size_t>(&QCircuit::observeQubit), py::call_guard<py::gil_scoped_release>())
+            .def("reset_qubit", py::overload_cast<size_t>(&QCircuit::resetQubit), py::call_guard<py::gil_scoped_release>())
+            .def("measure", [](QCircuit& circuit, const std::vector<size_t>& sites, std::optional<py::function> callback) {
+                     QCircuit::MeasurementCallback f;
+                     if(callback) {
+                         f = [&callback](size_t site, int bit) {
+                             py::gil_scoped_acquire acquire;
+                             (*callback)(site, bit);
+                         };
+                     }
+                     py::gil_scoped_release release;
+                     return circuit.measure(sites, f);
+                 },
+                 py::arg("sites"),
+                 py::arg("callback") = py::none())
+            .def("measure_all", [](QCircuit& circuit, std::optional<py::function> callback) {
+                     QCircuit::MeasurementCallback f;
+                     if(callback) {
+                         f = [&callback](size_t site, int bit) {
+                             py::gil_scoped_acquire acquire;
+                             (*callback)(site, bit);
+                         };
+                     }
+                     py::gil_scoped_release release;
+                     return circuit.measureAll(f);
+                 },
+                 py::arg("callback") = py::none())
+            .def("reset_qubits", py::overload_cast<const std::vector<size_t>&>(&QCircuit::resetQubits),
+                 py::arg("sites"), py::call_guard<py::gil_scoped_release>())
             .def("get_swap_path", &QCircuit::getSwapPath)
+            .def("set_seed", &QCircuit::setSeed)
+            .def("fork", [](const QCircuit& circuit, std::optional<std::uint32_t> seed) {
+                     return seed ? circuit.fork(*seed) : circuit.fork();
+                 },
+                 py::arg("seed") = py::none())
+            .def("__copy__", [](const QCircuit& circuit) { return circuit.fork(); })
+            .def("singular_values_at", &QCircuit::singularValuesAt)
             .def_property("cutoff", &QCircuit::getCutoff, &QCircuit::setCutoff)
-            .def_property("max_dim", &QCircuit::getMaxDim, &QCircuit::setMaxDim);
+            .def_property("max_dim", &QCircuit::getMaxDim, &QCircuit::setMaxDim)
+            .def_property("decomposition", &QCircuit::getDecomposition, &QCircuit::setDecomposition)
+            .def_property_readonly("last_truncation_error", &QCircuit::getLastTruncationError)
+            .def_property_readonly("truncation_errors", &QCircuit::getTruncationErrors)
+            .def("truncation_error", &QCircuit::getTruncationError, py::arg("link"))
+            .def_property("memory_budget", &QCircuit::getMemoryBudget, &QCircuit::setMemoryBudget)
+            .def("memory_usage", &QCircuit::memoryUsage)
+            .def_property_readonly("stats", [](const QCircuit& circuit) {
+                     const auto& stats = circuit.getStats();
+
+                     py::dict gate_counts;
+                     for(auto&& entry : stats.gate_counts) {
+                         gate_counts[py::str(CircuitStats::gateName(entry.first))] = entry.second;
+                     }
+                     py::dict histogram; // lower bound of Psi size -> (count, seconds)
+                     for(auto&& entry : stats.decomposition_histogram) {
+                         histogram[py::int_(size_t(1) << entry.first)] = py::make_tuple(entry.second.count, entry.second.seconds);
+                     }
+
+                     py::dict ret;
+                     ret["enabled"] = CircuitStats::enabled();
+                     ret["gate_counts"] = gate_counts;
+                     ret["decompositions"] = stats.decompositions;
+                     ret["decomposition_seconds"] = stats.decomposition_seconds;
+                     ret["decomposition_histogram"] = histogram;
+                     ret["bond_dims"] = circuit.bondDimensions();
+                     ret["max_bond_dims"] = stats.max_bond_dims;
+                     ret["cumulative_truncation_error"] = stats.cumulative_truncation_error;
+                     ret["cursor_hops"] = stats.cursor_hops;
+                     return ret;
+                 })
+            .def("reset_stats", &QCircuit::resetStats)
+            .def_property("gate_fusion", &QCircuit::getGateFusion, &QCircuit::setGateFusion)
+            .def_property("gate_kernels", &QCircuit::getGateKernels, &QCircuit::setGateKernels)
+            .def_property("gate_cache_capacity", &QCircuit::getGateCacheCapacity, &QCircuit::setGateCacheCapacity)
+            .def("save", py::overload_cast<const std::string&>(&QCircuit::save, py::const_),
+                 py::arg("filename"), py::call_guard<py::gil_scoped_release>())
+            .def_static("load", py::overload_cast<const std::string&>(&QCircuit::load),
+                        py::arg("filename"), py::call_guard<py::gil_scoped_release>())
+            .def(py::pickle(
+                [](const QCircuit& circuit) {
+                    std::stringstream ss;
+                    circuit.save(ss);
+                    return py::bytes(ss.str());
+                },
+                [](py::bytes data) {
+                    std::stringstream ss(static_cast<std::string>(data));
+                    return QCircuit::load(ss);
+                }));
     }
 }
@@ -5,8 +5,9 @@ namespace qcircuit {
     namespace py = pybind11;
 
     void init_quantum_gate(py::module& m) {
-        py::class_<OneSiteGate>(m, "OneSiteGate");
-        py::class_<TwoSiteGate>(m, "TwoSiteGate");
+        py::class_<Gate>(m, "Gate");
+        py::class_<OneSiteGate, Gate>(m, "OneSiteGate");
+        py::class_<TwoSiteGate, Gate>(m, "TwoSiteGate");
 
         py::class_<Id, OneSiteGate>(m, "Id").def(py::init<size_t>());
         py::class_<X, OneSiteGate>(m, "X").def(py::init<size_t>());
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <cmath>
+#include <sstream>
 #include <circuit_topology.hpp>
+#include <contraction_plan.hpp>
 
 
 TEST(CIRCUIT_TOPOLOGY_TEST, CHECK_CONNECTED_GRAPH) {
@@ -15,6 +17,7 @@ TEST(CIRCUIT_TOPOLOGY_TEST, CHECK_CONNECTED_GRAPH) {
     //    +- 2 --- 3 --- 4
 
     EXPECT_TRUE(topology.isConnectedGraph());
+    EXPECT_TRUE(topology.finalizedCopy().isConnectedGraph());
 }
 
 TEST(CIRCUIT_TOPOLOGY_TEST, CHECK_NOT_CONNECTED_GRAPH) {
@@ -28,4 +31,144 @@ TEST(CIRCUIT_TOPOLOGY_TEST, CHECK_NOT_CONNECTED_GRAPH) {
     //    +- 2     3 --- 4
 
     EXPECT_FALSE(topology.isConnectedGraph());
+    EXPECT_FALSE(topology.finalizedCopy().isConnectedGraph());
+}
+
+TEST(CONTRACTION_PLAN_TEST, CONTRACTION_ORDER) {
+    using namespace qcircuit;
+
+    // 3x3 grid
+    // 0 - 1 - 2
+    // |   |   |
+    // 3 - 4 - 5
+    // |   |   |
+    // 6 - 7 - 8
+    const size_t width = 3;
+    CircuitTopology topology(width*width);
+    for(size_t y = 0;y < width;y++) {
+        for(size_t x = 0;x < width;x++) {
+            if(x+1 < width) {
+                topology.generateLink(width*y + x, width*y + x+1);
+            }
+            if(y+1 < width) {
+                topology.generateLink(width*y + x, width*(y+1) + x);
+            }
+        }
+    }
+
+    ContractionPlan plan(topology);
+    EXPECT_EQ(2*topology.numberOfBits() - 1, plan.getNodes().size());
+    EXPECT_EQ(0, plan.getNodes().back().open_links);
+
+    size_t num_internal_nodes = 0;
+    for(auto&& level : plan.getLevels()) {
+        num_internal_nodes += level.size();
+    }
+    EXPECT_EQ(topology.numberOfBits() - 1, num_internal_nodes);
+
+    // Contracting in index order would leave 4 open links after sites 0-3.
+    EXPECT_LE(plan.maxOpenLinks(), 4);
+
+    // Every leaf is used exactly once.
+    std::vector<long> leaves;
+    long expected = 1;
+    for(size_t i = 0;i < topology.numberOfBits();i++) {
+        leaves.push_back(i+1);
+        expected *= i+1;
+    }
+    EXPECT_EQ(expected, plan.contract(leaves));
+}
+
+TEST(CIRCUIT_TOPOLOGY_TEST, FINALIZED_ROUTING_TABLE) {
+    using namespace qcircuit;
+
+    // Ring of 8 sites with a chord
+    CircuitTopology topology(8);
+    for(size_t i = 0;i < 8;i++) {
+        topology.generateLink(i, (i+1)%8);
+    }
+    topology.generateLink(1, 5);
+
+    CircuitTopology finalized = topology.finalizedCopy();
+    EXPECT_FALSE(topology.isFinalized());
+    EXPECT_TRUE(finalized.isFinalized());
+    EXPECT_THROW(finalized.generateLink(0, 4), QCircuitException);
+
+    for(size_t i = 0;i < 8;i++) {
+        for(size_t j = 0;j < 8;j++) {
+            EXPECT_EQ(topology.hasLinkBetween(i, j), finalized.hasLinkBetween(i, j));
+            if(topology.hasLinkBetween(i, j)) {
+                EXPECT_EQ(topology.getLinkIdBetween(i, j), finalized.getLinkIdBetween(i, j));
+            }
+            if(i != j) {
+                EXPECT_EQ(topology.getSwapPath(i, j).size(), finalized.getSwapPath(i, j).size());
+                EXPECT_EQ(j, finalized.getSwapPath(i, j).front());
+            }
+        }
+    }
+    EXPECT_THROW(finalized.getLinkIdBetween(0, 4), QCircuitException);
+
+    // The contraction plan is built once and shared with the copies.
+    EXPECT_THROW(topology.getContractionPlan(), QCircuitException);
+    CircuitTopology copied = finalized;
+    EXPECT_EQ(finalized.getContractionPlan(), copied.getContractionPlan());
+    EXPECT_EQ(2*finalized.numberOfBits() - 1, copied.getContractionPlan()->getNodes().size());
+
+    const auto origin = std::make_pair<size_t, size_t>(0, 1);
+    const auto destination = std::make_pair<size_t, size_t>(4, 5);
+    auto route = finalized.getRoute(origin, destination);
+    EXPECT_EQ(topology.getRoute(origin, destination).size(), route.size());
+    EXPECT_EQ(route.size(), finalized.getRouteLength(origin, destination));
+    EXPECT_EQ(5, route.back()); // 1 -> 5 via the chord
+}
+
+TEST(CIRCUIT_TOPOLOGY_TEST, NEIGHBOR_ORDER) {
+    using namespace qcircuit;
+    CircuitTopology topology(4);
+
+    topology.generateLink(2, 3);
+    topology.generateLink(0, 2);
+    topology.generateLink(1, 2);
+    topology.generateLink(0, 1);
+
+    // Neighbors are kept in order of link generation.
+    auto neighbors = topology.neighborsOf(2);
+    ASSERT_EQ(3, neighbors.size());
+    EXPECT_EQ(3, neighbors[0].site);
+    EXPECT_EQ(0, neighbors[1].site);
+    EXPECT_EQ(1, neighbors[2].site);
+    EXPECT_EQ(2, neighbors[2].link);
+
+    EXPECT_EQ(2, topology.neighborsOf(0).size());
+    EXPECT_EQ(3, topology.getLinkIdBetween(1, 0));
+}
+
+TEST(CIRCUIT_TOPOLOGY_TEST, SERIALIZATION) {
+    using namespace qcircuit;
+    CircuitTopology topology(4);
+
+    topology.generateLink(2, 3);
+    topology.generateLink(0, 2);
+    topology.generateLink(1, 2);
+    topology.generateLink(0, 1);
+    topology.finalize();
+
+    std::stringstream ss;
+    topology.write(ss);
+    auto restored = CircuitTopology::read(ss);
+
+    EXPECT_TRUE(restored.isFinalized());
+    ASSERT_EQ(topology.numberOfLinks(), restored.numberOfLinks());
+    for(size_t i = 0;i < topology.numberOfBits();i++) {
+        auto expected = topology.neighborsOf(i);
+        auto actual = restored.neighborsOf(i);
+        ASSERT_EQ(expected.size(), actual.size());
+        for(size_t k = 0;k < expected.size();k++) {
+            EXPECT_EQ(expected[k].site, actual[k].site);
+            EXPECT_EQ(expected[k].link, actual[k].link);
+        }
+    }
+
+    std::stringstream broken("QCTOPX");
+    EXPECT_THROW(CircuitTopology::read(broken), QCircuitException);
 }
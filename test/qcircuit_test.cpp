@@ -1,9 +1,16 @@
 #include <gtest/gtest.h>
 #include <cmath>
 #include <utility>
+#include <memory>
+#include <algorithm>
+#include <sstream>
 #include <itensor/util/print_macro.h>
 #include <qcircuit.hpp>
 #include <circuits.hpp>
+#include <circuit_pool.hpp>
+#include <circuit_prototype.hpp>
+#include <qasm_program.hpp>
+#include <parameter_sweep.hpp>
 
 TEST(QCIRCUIT_TEST, CHECK_INITIAL_CURSOR_POSITION) {
     using namespace qcircuit;
@@ -337,3 +344,1045 @@ TEST(CALCULATION_TEST, MULTIPLE_MEASUREMENT_TEST) {
     EXPECT_NEAR(1.0, prob0 + prob1, 1e-3);
     circuit.observeQubit(3);
 }
+
+TEST(CALCULATION_TEST, MEASURE_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 6;
+    const auto topology = make_chain(size);
+
+    /* GHZ state (1/sqrt(2))(|000000> + |111111>) */
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5);
+    circuit.apply(H(0));
+    for(size_t site = 0;site+1 < size;site++) {
+        circuit.apply(CNOT(site, site+1));
+    }
+
+    /* A subset of the qubits is projected one by one, and the rest follows. */
+    vector<size_t> order;
+    auto bits = circuit.measure({4, 1}, [&order](size_t site, int) { order.push_back(site); });
+    ASSERT_EQ(2, bits.size());
+    EXPECT_EQ(bits[0], bits[1]);
+    EXPECT_EQ(2, order.size());
+    for(size_t site = 0;site < size;site++) {
+        EXPECT_NEAR(bits[0] == 0 ? 1.0 : 0.0, circuit.probabilityOfZero(site), 1e-6);
+    }
+
+    /* Measuring all the qubits leaves the product state of the outcomes. */
+    QCircuit other(topology);
+    other.setCutoff(1e-5);
+    other.apply(H(0));
+    for(size_t site = 0;site+1 < size;site++) {
+        other.apply(CNOT(site, site+1));
+    }
+    size_t calls = 0;
+    const auto errors = other.getTruncationErrors();
+    auto all = other.measureAll([&calls](size_t, int) { calls++; });
+    EXPECT_EQ(size, calls);
+    EXPECT_EQ(errors, other.getTruncationErrors()); // the history of the circuit is kept
+    for(size_t site = 0;site < size;site++) {
+        EXPECT_EQ(all[0], all[site]);
+        EXPECT_NEAR(all[0] == 0 ? 1.0 : 0.0, other.probabilityOfZero(site), 1e-10);
+    }
+    for(auto dim : other.bondDimensions()) {
+        EXPECT_EQ(1, dim);
+    }
+
+    /* Reset is a measurement followed by a flip. */
+    other.apply(H(2));
+    other.resetQubits({2, 3});
+    EXPECT_NEAR(1.0, other.probabilityOfZero(2), 1e-6);
+    EXPECT_NEAR(1.0, other.probabilityOfZero(3), 1e-6);
+
+    EXPECT_THROW(other.measure({1, 1}), QCircuitException);
+    EXPECT_THROW(other.measure({size}), QCircuitException);
+}
+
+TEST(CALCULATION_TEST, MARGINAL_PROBABILITIES_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 8;
+    const auto topology = make_chain(size);
+
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5);
+    circuit.apply(H(0), Id(1));
+    circuit.apply(X(3), Id(4));
+    circuit.apply(H(5), Id(6));
+    circuit.apply(CNOT(5, 6));
+
+    auto prob0 = circuit.marginalProbabilities(0);
+    auto prob1 = circuit.marginalProbabilities(1);
+    ASSERT_EQ(size, prob0.size());
+    for(size_t i = 0;i < size;i++) {
+        EXPECT_NEAR(circuit.probabilityOf(i, 0), prob0[i], 1e-3);
+        EXPECT_NEAR(1.0, prob0[i] + prob1[i], 1e-3);
+    }
+    EXPECT_NEAR(0.5, prob0[0], 1e-3);
+    EXPECT_NEAR(0.0, prob0[3], 1e-3);
+    EXPECT_NEAR(0.5, prob0[6], 1e-3);
+
+    Z z0(0), z3(3), x2(2);
+    auto values = circuit.expectationValues({&z0, &z3, &x2});
+    EXPECT_NEAR(0.0, std::real(values[0]), 1e-3);
+    EXPECT_NEAR(-1.0, std::real(values[1]), 1e-3);
+    EXPECT_NEAR(0.0, std::real(values[2]), 1e-3);
+}
+
+TEST(CALCULATION_TEST, PAULI_EXPECTATION_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    EXPECT_THROW(PauliString("XQ"), QCircuitException);
+    EXPECT_THROW(PauliString(vector<PauliString::Factor>{{0, 'X'}, {0, 'Z'}}), QCircuitException);
+    EXPECT_EQ(2u, PauliString("IXIZ").weight());
+
+    // GHZ state on 4 qubits with a loop
+    CircuitTopology topology(4);
+    topology.generateLink(0, 1);
+    topology.generateLink(1, 2);
+    topology.generateLink(2, 3);
+    topology.generateLink(3, 0);
+    QCircuit circuit(topology);
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+    circuit.apply(CNOT(1, 2));
+    circuit.apply(CNOT(2, 3));
+
+    vector<PauliString> terms = {
+        PauliString("ZZII"), PauliString("XXXX", 0.5), PauliString({{3, 'Z'}, {0, 'Z'}}, -2.0), PauliString("IIII", 3.0),
+        PauliString("ZIII"), PauliString("YYXX"), PauliString("XIII"), PauliString("ZZZI"),
+    };
+    vector<double> expected = {1.0, 1.0, 1.0, 1.0, 0.0, -1.0, 0.0, 0.0};
+    auto values = circuit.pauliExpectations(terms);
+    auto parallel = circuit.pauliExpectations(terms, 2);
+    ASSERT_EQ(terms.size(), values.size());
+    for(size_t k = 0;k < terms.size();k++) {
+        EXPECT_NEAR(expected[k], std::real(values[k]), 1e-8);
+        EXPECT_NEAR(0.0, std::imag(values[k]), 1e-8);
+        EXPECT_NEAR(0.0, std::abs(values[k] - parallel[k]), 1e-12);
+    }
+    EXPECT_NEAR(1.0 + 0.5 - 2.0 + 3.0 - 1.0, std::real(circuit.expectation(terms)), 1e-8);
+
+    // single factors agree with expectationValues()
+    X x1(1);
+    EXPECT_NEAR(std::real(circuit.expectationValues({&x1})[0]), std::real(circuit.pauliExpectations({PauliString("IX")})[0]), 1e-10);
+    EXPECT_THROW(circuit.pauliExpectations({PauliString("IIIIZ")}), QCircuitException);
+}
+
+TEST(CALCULATION_TEST, SAMPLING_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 6;
+    const auto topology = make_chain(size);
+
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5);
+    circuit.apply(H(0), Id(1));
+    circuit.apply(CNOT(0, 1)); // Bell pair on (0, 1)
+    circuit.apply(X(4), Id(5));
+
+    const auto cursor = circuit.getCursor();
+    const size_t shots = 1000;
+    auto bits = circuit.sample(shots, 12345);
+    ASSERT_EQ(shots*size, bits.size());
+
+    size_t count_one = 0;
+    for(size_t k = 0;k < shots;k++) {
+        EXPECT_EQ(bits[k*size + 0], bits[k*size + 1]); // correlated
+        EXPECT_EQ(0, bits[k*size + 2]);
+        EXPECT_EQ(1, bits[k*size + 4]);
+        count_one += bits[k*size + 0];
+    }
+    EXPECT_NEAR(0.5, static_cast<double>(count_one)/shots, 0.1);
+
+    // the state is left untouched
+    EXPECT_EQ(cursor, circuit.getCursor());
+    EXPECT_NEAR(0.5, circuit.probabilityOfZero(0), 1e-3);
+
+    // same seed gives the same bitstrings
+    EXPECT_EQ(bits, circuit.sample(shots, 12345));
+}
+
+TEST(QUANTUM_GATE_TEST, GATE_MATRIX_TEST) {
+    using namespace qcircuit;
+
+    std::vector<Index> s = {Index(2, "SiteInd"), Index(2, "SiteInd")};
+
+    auto hadamard = (1.0/sqrt(2.0))*(Proj_0(0).op(s) + Proj_0_to_1(0).op(s))
+        + (1.0/sqrt(2.0))*(Proj_1_to_0(0).op(s) - Proj_1(0).op(s));
+    EXPECT_NEAR(0.0, norm(H(0).op(s) - hadamard), 1e-12);
+
+    auto cnot = Proj_0(0).op(s)*Id(1).op(s) + Proj_1(0).op(s)*X(1).op(s);
+    EXPECT_NEAR(0.0, norm(CNOT(0, 1).op(s) - cnot), 1e-12);
+
+    auto cuu = Proj_0(0).op(s)*Id(1).op(s) + Proj_1(0).op(s)*UniversalUnitary(1, 0.1, 0.2, 0.3).op(s);
+    EXPECT_NEAR(0.0, norm(CUniversalUnitary(0, 1, 0.1, 0.2, 0.3).op(s) - cuu), 1e-12);
+}
+
+TEST(QUANTUM_GATE_TEST, GATE_CACHE_TEST) {
+    using namespace qcircuit;
+
+    std::vector<Index> s = {Index(2, "SiteInd"), Index(2, "SiteInd")};
+    GateCache cache(3);
+
+    cache.op(H(0), s);
+    cache.op(H(0), s);
+    EXPECT_EQ(1, cache.size());
+
+    cache.op(H(1), s);                  // different site
+    cache.op(P(0, 0.5), s);             // different type
+    EXPECT_EQ(3, cache.size());
+    EXPECT_NEAR(0.0, norm(cache.op(P(0, 0.5), s) - P(0, 0.5).op(s)), 1e-12);
+
+    cache.op(P(0, 0.25), s);            // different parameter exceeds capacity
+    EXPECT_EQ(1, cache.size());
+}
+
+TEST(CALCULATION_TEST, GATE_FUSION_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 6;
+    const auto topology = make_chain(size);
+
+    QCircuit fused(topology);
+    fused.setCutoff(1e-5).setGateFusion(true);
+    QCircuit reference(topology, fused.site());
+    reference.setCutoff(1e-5);
+
+    for(auto circuit : {&fused, &reference}) {
+        circuit->apply(UniversalUnitary(2, 0.3, 0.2, 0.1));
+        circuit->apply(UniversalUnitary(3, 1.1, 0.5, 0.4));
+        circuit->apply(CNOT(2, 3));
+        circuit->apply(H(2)); // on the cursor, so the cursor should not move
+        EXPECT_EQ((pair<size_t, size_t>(2, 3)), circuit->getCursor());
+        circuit->apply(CP(3, 2, 0.7));
+        circuit->apply(CNOT(3, 4));
+    }
+
+    vector<ITensor> op;
+    op.reserve(size);
+    for(size_t i = 0;i < size;i++) {
+        op.push_back(fused.generateTensorOp(Id(i)));
+    }
+
+    EXPECT_NEAR(1.0, abs(overlap(fused, op, reference)), 1e-3);
+    for(size_t i = 0;i < size;i++) {
+        EXPECT_NEAR(reference.probabilityOfZero(i), fused.probabilityOfZero(i), 1e-3);
+    }
+}
+
+TEST(QUANTUM_GATE_TEST, GATE_KERNELS_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    vector<Index> s = {Index(2, "Site,n=0"), Index(2, "Site,n=1")};
+    auto a = Index(3, "Link"), b = Index(5, "Link");
+    // physical indices are neither the first nor adjacent in the storage
+    auto T = randomITensorC(a, s[1], b, s[0]);
+
+    vector<shared_ptr<TwoSiteGate>> two_site_gates = {
+        make_shared<CZ>(0, 1), make_shared<CP>(1, 0, 0.3), make_shared<CNOT>(1, 0), make_shared<Swap>(0, 1),
+        make_shared<CUniversalUnitary>(0, 1, 0.1, 0.2, 0.3),
+    };
+    for(auto&& gate : two_site_gates) {
+        auto expected = gate->op(s) * prime(T, s[0], s[1]);
+        auto actual = T;
+        gate_kernels::apply<2>(actual, gate->matrix(), {s[gate->site1], s[gate->site2]});
+        EXPECT_NEAR(0.0, norm(actual - expected), 1e-10);
+    }
+
+    vector<shared_ptr<OneSiteGate>> one_site_gates = {
+        make_shared<Z>(0), make_shared<X>(1), make_shared<H>(0), make_shared<UniversalUnitary>(1, 0.4, 0.5, 0.6),
+    };
+    for(auto&& gate : one_site_gates) {
+        auto expected = gate->op(s) * prime(T, s[gate->site]);
+        auto actual = T;
+        gate_kernels::apply<1>(actual, gate->matrix(), {s[gate->site]});
+        EXPECT_NEAR(0.0, norm(actual - expected), 1e-10);
+    }
+
+    // real storage with a complex gate
+    auto R = randomITensor(s[0], a, s[1]);
+    auto expected = CP(0, 1, 0.3).op(s) * prime(R, s[0], s[1]);
+    gate_kernels::apply<2>(R, CP(0, 1, 0.3).matrix(), {s[0], s[1]});
+    EXPECT_NEAR(0.0, norm(R - expected), 1e-10);
+}
+
+TEST(QUANTUM_GATE_TEST, CONTRACT_DIAGONAL_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    auto a = Index(3, "Link"), b = Index(4, "Link"), c = Index(4, "Link"), s = Index(2, "Site");
+    vector<Real> values = {0.7, 0.5, 0.1, 0.0};
+
+    for(auto&& T : {randomITensor(a, b, s), randomITensorC(b, s, a), randomITensor(s, a, b)}) {
+        auto expected = T * diagITensor(values, b, c);
+        auto actual = T;
+        gate_kernels::contractDiagonal(actual, b, c, values);
+        EXPECT_TRUE(hasIndex(actual, c));
+        EXPECT_FALSE(hasIndex(actual, b));
+        EXPECT_NEAR(0.0, norm(actual - expected), 1e-12);
+    }
+
+    // shared storage is copied before being scaled
+    auto T = randomITensor(a, b);
+    auto element = elt(T, a=1, b=3);
+    auto copy = T;
+    gate_kernels::contractDiagonal(copy, b, c, values);
+    EXPECT_EQ(element, elt(T, a=1, b=3));
+    EXPECT_NEAR(0.1*element, elt(copy, a=1, c=3), 1e-12);
+}
+
+TEST(CALCULATION_TEST, GATE_KERNELS_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 6;
+    const auto topology = make_chain(size);
+
+    QCircuit kernels(topology);
+    kernels.setCutoff(1e-5);
+    QCircuit reference(topology, kernels.site());
+    reference.setCutoff(1e-5).setGateKernels(false);
+    EXPECT_TRUE(kernels.getGateKernels());
+
+    for(auto circuit : {&kernels, &reference}) {
+        circuit->setSeed(1);
+        circuit->apply(H(0));
+        circuit->apply(CNOT(0, 1));
+        circuit->apply(UniversalUnitary(1, 0.3, 0.2, 0.1));
+        circuit->apply(CUniversalUnitary(1, 2, 1.1, 0.5, 0.4));
+        circuit->apply(CP(2, 1, 0.7));
+        circuit->apply(Swap(2, 3));
+        circuit->apply(CZ(3, 4));
+        circuit->apply(Y(4));
+        circuit->apply(CNOT(4, 5));
+        circuit->observeQubit(1);
+    }
+
+    vector<ITensor> op;
+    op.reserve(size);
+    for(size_t i = 0;i < size;i++) {
+        op.push_back(kernels.generateTensorOp(Id(i)));
+    }
+
+    EXPECT_NEAR(1.0, abs(overlap(kernels, op, reference)), 1e-3);
+    for(size_t i = 0;i < size;i++) {
+        EXPECT_NEAR(reference.probabilityOfZero(i), kernels.probabilityOfZero(i), 1e-3);
+    }
+}
+
+TEST(CALCULATION_TEST, ONE_SITE_GATE_ABSORPTION_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_ibmq_topology();
+
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5);
+    const auto cursor = circuit.getCursor();
+
+    circuit.apply(X(40));  // far from the cursor
+    circuit.apply(H(52));
+    circuit.apply(UniversalUnitary(26, M_PI, 0.0, 0.0)); // equivalent to Y up to phase
+    EXPECT_EQ(cursor, circuit.getCursor());
+
+    EXPECT_NEAR(0.0, circuit.probabilityOfZero(40), 1e-3);
+    EXPECT_NEAR(0.5, circuit.probabilityOfZero(52), 1e-3);
+    EXPECT_NEAR(0.0, circuit.probabilityOfZero(26), 1e-3);
+
+    circuit.apply(Proj_1(40)); // non-unitary gates still go through the cursor
+    EXPECT_TRUE(circuit.getCursor().first == 40 || circuit.getCursor().second == 40);
+}
+
+TEST(CALCULATION_TEST, CURSOR_SCHEDULING_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 8;
+    const auto topology = make_chain(size, false);
+
+    // Alternating between both ends of the chain in program order.
+    vector<unique_ptr<Gate>> gates;
+    gates.emplace_back(new H(0));
+    gates.emplace_back(new CNOT(0, 1));
+    gates.emplace_back(new CNOT(6, 7));
+    gates.emplace_back(new CNOT(1, 2));
+    gates.emplace_back(new CNOT(5, 6));
+    gates.emplace_back(new CZ(1, 2));
+    gates.emplace_back(new P(2, 0.3)); // commutes with CZ(1, 2)
+    gates.emplace_back(new Proj_0(7));
+    gates.emplace_back(new CNOT(2, 3));
+
+    vector<const Gate*> gate_list;
+    for(auto&& gate : gates) {
+        gate_list.push_back(gate.get());
+    }
+
+    QCircuit scheduled(topology);
+    scheduled.setCutoff(1e-5);
+    QCircuit reference(topology, scheduled.site());
+    reference.setCutoff(1e-5);
+
+    auto report = scheduled.applyScheduled(gate_list);
+    for(auto gate : gate_list) {
+        reference.apply(*gate);
+    }
+    EXPECT_LT(report.shifts_after, report.shifts_before);
+    EXPECT_LE(report.decompositions_after, report.decompositions_before);
+    EXPECT_LE(report.decompositions_after, report.shifts_after); // clean shifts do not decompose
+
+    CursorScheduler scheduler(topology);
+    auto order = scheduler.schedule(make_pair<size_t, size_t>(0, 1), gate_list);
+    ASSERT_EQ(gate_list.size(), order.size());
+    auto position = [&order](size_t j) {
+        return find(order.begin(), order.end(), j) - order.begin();
+    };
+    EXPECT_LT(position(1), position(3)); // CNOT(0, 1) -> CNOT(1, 2)
+    EXPECT_LT(position(3), position(5)); // CNOT(1, 2) -> CZ(1, 2)
+    EXPECT_LT(position(5), position(8)); // CZ(1, 2) -> CNOT(2, 3)
+    EXPECT_LT(position(6), position(8)); // P(2) -> CNOT(2, 3)
+
+    for(size_t i = 0;i < size;i++) {
+        EXPECT_NEAR(reference.probabilityOfZero(i), scheduled.probabilityOfZero(i), 1e-3);
+    }
+}
+
+TEST(CALCULATION_TEST, APPLY_ALL_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 5;
+    const auto topology = make_chain(size);
+
+    QCircuit batched(topology);
+    batched.setCutoff(1e-5);
+    QCircuit reference(topology, batched.site());
+    reference.setCutoff(1e-5);
+
+    auto code = [](GateOpcode opcode) { return static_cast<int32_t>(opcode); };
+    vector<GateSpec> specs = {
+        {code(GateOpcode::H), 0, 0, 0.0, 0.0, 0.0},
+        {code(GateOpcode::CNOT), 0, 1, 0.0, 0.0, 0.0},
+        {code(GateOpcode::UniversalUnitary), 3, 0, 0.4, 0.2, 0.1},
+        {code(GateOpcode::CP), 3, 2, 0.7, 0.0, 0.0},
+        {code(GateOpcode::Swap), 1, 2, 0.0, 0.0, 0.0},
+    };
+    batched.applyAll(specs);
+
+    reference.apply(H(0));
+    reference.apply(CNOT(0, 1));
+    reference.apply(UniversalUnitary(3, 0.4, 0.2, 0.1));
+    reference.apply(CP(3, 2, 0.7));
+    reference.apply(Swap(1, 2));
+
+    for(size_t i = 0;i < size;i++) {
+        EXPECT_NEAR(reference.probabilityOfZero(i), batched.probabilityOfZero(i), 1e-3);
+    }
+
+    EXPECT_THROW(batched.applyAll({{-1, 0, 0, 0.0, 0.0, 0.0}}), QCircuitException);
+    EXPECT_THROW(batched.applyAll({{code(GateOpcode::CNOT), 0, size, 0.0, 0.0, 0.0}}), QCircuitException);
+}
+
+TEST(CALCULATION_TEST, CIRCUIT_POOL_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 4;
+    const auto topology = make_chain(size);
+
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5);
+    CircuitPool pool(circuit, 3);
+    pool.setSeed(1);
+
+    pool.forEach([](QCircuit& c, size_t i) {
+        c.apply(UniversalUnitary(0, i*M_PI/4, 0.0, 0.0));
+        c.apply(CNOT(0, 1));
+    });
+
+    auto probs = pool.marginalProbabilities();
+    ASSERT_EQ(3, probs.size());
+    for(size_t i = 0;i < pool.size();i++) {
+        double expected = pow(cos(i*M_PI/8), 2);
+        EXPECT_NEAR(expected, probs[i][0], 1e-3);
+        EXPECT_NEAR(expected, probs[i][1], 1e-3);
+        EXPECT_NEAR(1.0, probs[i][2], 1e-3);
+    }
+
+    EXPECT_THROW(pool.forEach([](QCircuit& c, size_t i) {
+                     if(i == 1) {
+                         c.apply(CNOT(0, 2)); // no link between 0 and 2
+                     }
+                 }), QCircuitException);
+}
+
+TEST(CALCULATION_TEST, CONST_OVERLAP_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const size_t size = 6;
+    const auto topology = make_chain(size);
+
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5);
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+    circuit.apply(UniversalUnitary(1, 0.3, 0.2, 0.1));
+
+    QCircuit moved = circuit; // same state with a different cursor position
+    moved.moveCursorTo(3, 4);
+
+    vector<ITensor> op;
+    op.reserve(size);
+    for(size_t i = 0;i < size;i++) {
+        op.push_back(circuit.generateTensorOp(Id(i)));
+    }
+
+    const auto cursor = circuit.getCursor();
+    const auto psi = circuit.Psiref();
+    EXPECT_NEAR(1.0, abs(overlap(circuit, op, moved)), 1e-3);
+    EXPECT_NEAR(1.0, abs(overlap(moved, op, circuit)), 1e-3);
+    EXPECT_EQ(cursor, circuit.getCursor());
+    EXPECT_NEAR(0.0, norm(psi - circuit.Psiref()), 1e-12);
+}
+
+TEST(QCIRCUIT_TEST, SHARED_TOPOLOGY_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    QCircuit circuit(make_chain(4));
+    EXPECT_TRUE(circuit.getTopology().isFinalized());
+
+    QCircuit replica(circuit.getSharedTopology(), circuit.site());
+    EXPECT_EQ(circuit.getSharedTopology(), replica.getSharedTopology());
+
+    QCircuit copied = circuit;
+    EXPECT_EQ(&circuit.getTopology(), &copied.getTopology());
+
+    /* Circuits on copies of a finalized topology share the contraction plan. */
+    const auto topology = make_chain(4).finalizedCopy();
+    QCircuit circuit1(topology), circuit2(topology);
+    EXPECT_EQ(&circuit1.getContractionPlan(), &circuit2.getContractionPlan());
+    EXPECT_EQ(&replica.getContractionPlan(), &circuit.getContractionPlan());
+}
+
+TEST(CALCULATION_TEST, SINGULAR_VALUES_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_chain(4, false);
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5);
+
+    auto initial = circuit.singularValuesAt(topology.getLinkIdBetween(0, 1));
+    ASSERT_EQ(1, initial.size());
+    EXPECT_NEAR(1.0, initial[0], 1e-12);
+
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+    circuit.apply(CNOT(1, 2)); // decomposes the bond (0, 1)
+
+    auto values = circuit.singularValuesAt(topology.getLinkIdBetween(0, 1));
+    ASSERT_EQ(2, values.size());
+    EXPECT_NEAR(1/sqrt(2), values[0], 1e-3);
+    EXPECT_NEAR(1/sqrt(2), values[1], 1e-3);
+
+    circuit.apply(CNOT(2, 3));
+    circuit.apply(CNOT(0, 1)); // moves back through the bonds with inverted singular values
+    EXPECT_NEAR(0.5, circuit.probabilityOfZero(0), 1e-3);
+    EXPECT_NEAR(0.5, circuit.probabilityOfZero(3), 1e-3);
+}
+
+TEST(DECOMPOSITION_TEST, RANDOMIZED_SVD_TEST) {
+    using namespace qcircuit;
+
+    auto i = Index(8), j = Index(8), k = Index(8), l = Index(8);
+    auto bond = Index(3);
+    ITensor T = randomITensor(i, j, bond)*randomITensor(bond, k, l); // rank 3
+
+    ITensor U(i, j), S, V;
+    auto spec = Decomposition::randomizedSvd(T, U, S, V, {"MaxDim", 3, "Oversampling", 4});
+    EXPECT_NEAR(0.0, norm(T - U*S*V)/norm(T), 1e-8);
+    EXPECT_NEAR(0.0, spec.truncerr(), 1e-8);
+
+    /* Rank 12 with decaying weights: the sketch of 3 + 4 vectors misses part of T. */
+    auto left = Index(12), right = Index(12);
+    std::vector<Real> weights;
+    for(int n = 0;n < 12;n++) {
+        weights.push_back(std::pow(0.5, n));
+    }
+    ITensor R = randomITensor(i, j, left)*diagITensor(weights, left, right)*randomITensor(right, k, l);
+    ITensor Ur(i, j), Sr, Vr;
+    auto lossy = Decomposition::randomizedSvd(R, Ur, Sr, Vr, {"MaxDim", 3, "Oversampling", 4});
+    ITensor Uf(i, j), Sf, Vf;
+    auto full = svd(R, Uf, Sf, Vf, {"MaxDim", 3});
+    EXPECT_NEAR(sqr(norm(R - Ur*Sr*Vr)/norm(R)), lossy.truncerr(), 1e-10);
+    EXPECT_GE(lossy.truncerr(), full.truncerr() - 1e-10); // the full SVD is optimal
+    EXPECT_NEAR(full.truncerr(), lossy.truncerr(), 1e-2);
+
+    QCircuit circuit(make_chain(6));
+    EXPECT_THROW(circuit.setDecomposition("Unknown"), QCircuitException);
+    circuit.setCutoff(1e-5).setMaxDim(2).setDecomposition("Randomized");
+    circuit.apply(H(0));
+    for(size_t site = 0;site + 1 < 6;site++) {
+        circuit.apply(CNOT(site, site+1));
+    }
+    for(size_t site = 0;site < 6;site++) {
+        EXPECT_NEAR(0.5, circuit.probabilityOfZero(site), 1e-3);
+    }
+    EXPECT_NEAR(0.0, circuit.getLastTruncationError(), 1e-8);
+}
+
+TEST(DECOMPOSITION_TEST, DEVICE_SVD_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    QCircuit circuit(make_chain(3, false));
+    if(!Decomposition::hasDevice()) {
+        EXPECT_THROW(circuit.setDecomposition("Device"), QCircuitException);
+        return;
+    }
+
+    auto a = Index(6, "Row"), b = Index(2, "Row"), c = Index(10, "Col");
+    for(auto&& T : {randomITensor(a, c, b), randomITensorC(c, a, b)}) {
+        ITensor U(a, b), S, V;
+        auto spec = Decomposition::decompose(T, U, S, V, {"Decomposition", "Device", "DeviceMinDim", 1});
+        EXPECT_NEAR(0.0, norm(T - U*S*V), 1e-10);
+        EXPECT_NEAR(0.0, spec.truncerr(), 1e-14);
+
+        ITensor Uh(a, b), Sh, Vh;
+        auto host = svd(T, Uh, Sh, Vh);
+        ASSERT_EQ(host.numEigsKept(), spec.numEigsKept());
+        for(long n = 0;n < host.numEigsKept();n++) {
+            EXPECT_NEAR(host.eigsKept()(n), spec.eigsKept()(n), 1e-10);
+        }
+
+        ITensor Ut(a, b), St, Vt;
+        auto truncated = Decomposition::decompose(T, Ut, St, Vt, {"Decomposition", "Device", "DeviceMinDim", 1, "MaxDim", 4});
+        ITensor Uf(a, b), Sf, Vf;
+        auto full = svd(T, Uf, Sf, Vf, {"MaxDim", 4});
+        EXPECT_NEAR(norm(T - Uf*Sf*Vf), norm(T - Ut*St*Vt), 1e-10);
+        EXPECT_NEAR(full.truncerr(), truncated.truncerr(), 1e-10);
+
+        /* The scale factor of a normalized tensor is not in its storage. */
+        auto scaled = T;
+        scaled /= norm(scaled);
+        scaled *= 3.0;
+        ITensor Us(a, b), Ss, Vs;
+        Decomposition::decompose(scaled, Us, Ss, Vs, {"Decomposition", "Device", "DeviceMinDim", 1});
+        ITensor Uhs(a, b), Shs, Vhs;
+        svd(scaled, Uhs, Shs, Vhs);
+        EXPECT_NEAR(0.0, norm(scaled - Us*Ss*Vs), 1e-10);
+        EXPECT_NEAR(norm(Shs), norm(Ss), 1e-10);
+        EXPECT_NEAR(3.0, norm(Ss), 1e-10);
+    }
+
+    circuit.setDecomposition("Device");
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+    circuit.apply(CNOT(1, 2));
+    EXPECT_NEAR(0.5, circuit.probabilityOfZero(2), 1e-10);
+}
+
+TEST(CALCULATION_TEST, CLEAN_CURSOR_SHIFT_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_ibmq_topology();
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5);
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+
+    // Only the first shift decomposes the entangled bond; the rest are transport only.
+    circuit.moveCursorAlong({2, 3, 4, 6, 11, 10, 9, 8, 7});
+    circuit.moveCursorTo(0, 1);
+
+    EXPECT_NEAR(0.5, circuit.probabilityOfZero(0), 1e-3);
+    EXPECT_NEAR(0.5, circuit.probabilityOfZero(1), 1e-3);
+    EXPECT_NEAR(1.0, circuit.probabilityOfZero(10), 1e-3);
+
+    circuit.apply(CNOT(0, 1)); // back to |+>|0>
+    EXPECT_NEAR(1.0, circuit.probabilityOfZero(1), 1e-3);
+}
+
+TEST(CALCULATION_TEST, INCREMENTAL_MERGE_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_ibmq_topology();
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-8);
+
+    // Every shift decomposes a modified Psi, so the staying site reuses its absorbed tensor.
+    const vector<size_t> path = {0, 1, 2, 3, 4, 6, 11};
+    circuit.apply(H(0));
+    for(size_t k = 0;k+1 < path.size();k++) {
+        circuit.apply(CNOT(path[k], path[k+1]));
+    }
+    for(auto site : path) {
+        EXPECT_NEAR(0.5, circuit.probabilityOfZero(site), 1e-6);
+    }
+
+    for(size_t k = path.size()-1;k > 0;k--) {
+        circuit.apply(CNOT(path[k-1], path[k]));
+    }
+    circuit.apply(H(0));
+    for(auto site : path) {
+        EXPECT_NEAR(1.0, circuit.probabilityOfZero(site), 1e-6);
+    }
+}
+
+TEST(CALCULATION_TEST, LOGICAL_ADDRESSING_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_chain(5, false);
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-5).setSeed(1);
+
+    auto spec = [](GateOpcode opcode, uint32_t qubit1, uint32_t qubit2) {
+        return GateSpec{static_cast<int32_t>(opcode), qubit1, qubit2, 0.0, 0.0, 0.0};
+    };
+    circuit.applyAllLogical({
+        spec(GateOpcode::H, 0, 0),
+        spec(GateOpcode::Swap, 0, 4),   // relabeled only
+        spec(GateOpcode::CNOT, 4, 1),   // on the sites (0, 1)
+        spec(GateOpcode::CNOT, 0, 2),   // qubit 2 is moved from the site 2 to 3, next to qubit 0
+    });
+    EXPECT_EQ((vector<size_t>{4, 1, 3, 2, 0}), circuit.getLayout());
+    EXPECT_EQ(2, circuit.qubitAt(3));
+
+    // GHZ state on the logical qubits 0, 1, 2, 4
+    for(size_t qubit : {0, 1, 2, 4}) {
+        EXPECT_NEAR(0.5, circuit.probabilityOfZero(circuit.siteOf(qubit)), 1e-3);
+    }
+    EXPECT_NEAR(1.0, circuit.probabilityOfZero(circuit.siteOf(3)), 1e-3);
+    auto bit = circuit.observeQubit(circuit.siteOf(0));
+    for(size_t qubit : {1, 2, 4}) {
+        EXPECT_NEAR(bit == 0 ? 1.0 : 0.0, circuit.probabilityOfZero(circuit.siteOf(qubit)), 1e-3);
+    }
+
+    // exchangeSites() moves states and labels together
+    auto before = circuit.probabilityOfZero(circuit.siteOf(3));
+    circuit.exchangeSites(2, 3);
+    EXPECT_EQ(3, circuit.siteOf(3));
+    EXPECT_NEAR(before, circuit.probabilityOfZero(circuit.siteOf(3)), 1e-3);
+}
+
+TEST(CALCULATION_TEST, MEMORY_BUDGET_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_ibmq_topology();
+    QCircuit unbounded(topology);
+    QCircuit bounded(topology);
+
+    // The initial product state exactly fits, so no bond can grow.
+    bounded.setMemoryBudget(bounded.memoryUsage());
+
+    for(auto circuit : {&unbounded, &bounded}) {
+        circuit->apply(H(0));
+        circuit->apply(CNOT(0, 1));
+        circuit->moveCursorTo(2, 3);
+    }
+
+    EXPECT_LE(bounded.memoryUsage(), bounded.getMemoryBudget());
+    EXPECT_GT(unbounded.memoryUsage(), bounded.memoryUsage());
+
+    auto max_error = [](const QCircuit& circuit) {
+        auto errors = circuit.getTruncationErrors();
+        return *max_element(errors.begin(), errors.end());
+    };
+    EXPECT_NEAR(0.0, max_error(unbounded), 1e-8);
+    EXPECT_NEAR(0.5, max_error(bounded), 1e-8);
+}
+
+TEST(CALCULATION_TEST, CHECKPOINT_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_ibmq_topology();
+    QCircuit circuit(topology);
+    circuit.setCutoff(1e-8);
+    circuit.setSeed(7);
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+    circuit.apply(CNOT(1, 2));
+
+    stringstream ss;
+    circuit.save(ss);
+    QCircuit restored = QCircuit::load(ss);
+
+    EXPECT_EQ(circuit.getCursor(), restored.getCursor());
+    EXPECT_DOUBLE_EQ(circuit.getCutoff(), restored.getCutoff());
+
+    // Both continue the same way, including the random engine.
+    for(auto target : {&circuit, &restored}) {
+        target->apply(H(3));
+        target->apply(CNOT(3, 4));
+    }
+    auto expected = circuit.marginalProbabilities();
+    auto actual = restored.marginalProbabilities();
+    ASSERT_EQ(expected.size(), actual.size());
+    for(size_t i = 0;i < expected.size();i++) {
+        EXPECT_NEAR(expected[i], actual[i], 1e-10);
+    }
+    EXPECT_EQ(circuit.observeQubit(0), restored.observeQubit(0));
+    EXPECT_EQ(circuit.observeQubit(3), restored.observeQubit(3));
+}
+
+TEST(CALCULATION_TEST, FORK_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_ibmq_topology();
+    QCircuit circuit(topology);
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+
+    QCircuit branch = circuit.fork(1);
+    EXPECT_EQ(&circuit.getTopology(), &branch.getTopology());
+
+    // Only the tensors touched by the branch are duplicated.
+    branch.apply(X(1));
+    branch.apply(CNOT(1, 2));
+    EXPECT_EQ(circuit.Mref(10).store(), branch.Mref(10).store());
+    EXPECT_NEAR(1.0, circuit.probabilityOfZero(2), 1e-6);
+    EXPECT_NEAR(0.5, branch.probabilityOfZero(2), 1e-6);
+}
+
+TEST(CALCULATION_TEST, PROTOTYPE_AND_RESET_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_ibmq_topology();
+    CircuitPrototype prototype(topology);
+    EXPECT_THROW(CircuitPrototype(topology, {make_pair(1.0, 0.0)}), QCircuitException);
+
+    auto circuit = prototype.stamp(1);
+    auto other = prototype.stamp(2);
+    EXPECT_EQ(&circuit.getTopology(), &other.getTopology());
+    EXPECT_EQ(circuit.site(0), other.site(0));
+
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+    circuit.applyLogical(GateSpec{static_cast<int32_t>(GateOpcode::Swap), 1, 2, 0.0, 0.0, 0.0});
+    EXPECT_NEAR(0.5, circuit.probabilityOfZero(1), 1e-6);
+    EXPECT_NEAR(1.0, other.probabilityOfZero(1), 1e-6); // stamps are independent
+
+    circuit.reset();
+    EXPECT_EQ(circuit.getLayout(), other.getLayout());
+    EXPECT_EQ(circuit.getCursor(), other.getCursor());
+    for(auto bond_dim : circuit.bondDimensions()) {
+        EXPECT_EQ(1, bond_dim);
+    }
+    auto probabilities = circuit.marginalProbabilities();
+    for(auto p : probabilities) {
+        EXPECT_NEAR(1.0, p, 1e-10);
+    }
+    vector<ITensor> op;
+    for(size_t i = 0;i < circuit.size();i++) {
+        op.push_back(Id(i).op(circuit.site()));
+    }
+    EXPECT_NEAR(1.0, abs(overlap(circuit, op, other)), 1e-10);
+
+    // the state recorded by markInitialState()
+    circuit.apply(X(3));
+    CircuitPrototype excited(circuit);
+    auto stamped = excited.stamp(3);
+    stamped.apply(H(0));
+    stamped.reset();
+    EXPECT_NEAR(0.0, stamped.probabilityOfZero(3), 1e-10);
+    EXPECT_NEAR(1.0, stamped.probabilityOfZero(0), 1e-10);
+
+    // fresh physical indices
+    auto fresh = prototype.stampWithFreshIndices(4);
+    EXPECT_NE(fresh.site(0), circuit.site(0));
+    fresh.apply(X(2));
+    EXPECT_NEAR(0.0, fresh.probabilityOfZero(2), 1e-10);
+    fresh.reset();
+    EXPECT_NEAR(1.0, fresh.probabilityOfZero(2), 1e-10);
+}
+
+TEST(CALCULATION_TEST, STATS_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_ibmq_topology();
+    QCircuit circuit(topology);
+    circuit.apply(H(0));
+    circuit.apply(CNOT(0, 1));
+    circuit.apply(CNOT(1, 2));
+    circuit.apply(CNOT(0, 1));
+
+    const auto& stats = circuit.getStats();
+    if(!CircuitStats::enabled()) {
+        EXPECT_EQ(0, stats.decompositions);
+        EXPECT_EQ(0, stats.cursor_hops);
+        return;
+    }
+
+    EXPECT_EQ(1, stats.gate_counts.at(typeid(H)));
+    EXPECT_EQ(3, stats.gate_counts.at(typeid(CNOT)));
+    EXPECT_EQ("CNOT", CircuitStats::gateName(typeid(CNOT)));
+    EXPECT_EQ(2, stats.cursor_hops); // (0, 1) -> (1, 2) -> (0, 1)
+    EXPECT_EQ(2, stats.decompositions);
+    EXPECT_EQ(2, stats.max_bond_dims[topology.getLinkIdBetween(1, 2)]);
+
+    circuit.resetStats();
+    EXPECT_EQ(0, circuit.getStats().cursor_hops);
+    EXPECT_EQ(circuit.bondDimensions(), circuit.getStats().max_bond_dims);
+
+    /* The identity gate on the dummy site is not counted. */
+    circuit.apply(H(circuit.getCursor().first));
+    ASSERT_EQ(1, circuit.getStats().gate_counts.size());
+    EXPECT_EQ(1, circuit.getStats().gate_counts.at(typeid(H)));
+
+    /* The scheduler counts the decompositions as the circuit does: one per move from a modified cursor. */
+    vector<unique_ptr<Gate>> gates;
+    gates.emplace_back(new CNOT(1, 2));
+    gates.emplace_back(new CNOT(0, 1));
+    gates.emplace_back(new CZ(1, 2));
+    vector<const Gate*> gate_list;
+    for(auto&& gate : gates) {
+        gate_list.push_back(gate.get());
+    }
+    circuit.resetStats();
+    auto report = circuit.applyScheduled(gate_list);
+    EXPECT_EQ(3, report.decompositions_after);
+    EXPECT_EQ(report.decompositions_after, circuit.getStats().decompositions);
+}
+
+TEST(CALCULATION_TEST, ROUTING_STATS_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    if(!CircuitStats::enabled()) {
+        return;
+    }
+
+    const auto topology = make_chain(6, false);
+    auto spec = [](GateOpcode opcode, uint32_t qubit1, uint32_t qubit2) {
+        return GateSpec{static_cast<int32_t>(opcode), qubit1, qubit2, 0.0, 0.0, 0.0};
+    };
+
+    /* A routed CNOT pays one decomposition per hop, as the physical Swap chain does. */
+    QCircuit routed(topology);
+    routed.applyAllLogical({spec(GateOpcode::H, 0, 0), spec(GateOpcode::CNOT, 0, 3)});
+    QCircuit baseline(topology, routed.site());
+    baseline.apply(H(0));
+    baseline.apply(Swap(3, 2));
+    baseline.apply(Swap(2, 1));
+    baseline.apply(CNOT(0, 1));
+    EXPECT_EQ(3, routed.getStats().decompositions); // two hops and the move back onto the sites (0, 1)
+    EXPECT_EQ(baseline.getStats().decompositions, routed.getStats().decompositions);
+    vector<ITensor> identity;
+    for(size_t i = 0;i < routed.size();i++) {
+        identity.push_back(routed.generateTensorOp(Id(i)));
+    }
+    EXPECT_NEAR(1.0, std::abs(overlap(routed, identity, baseline)), 1e-6);
+
+    /* A logical Swap away from the cursor costs nothing, a physical one a decomposition. */
+    routed.applyLogical(spec(GateOpcode::Swap, 4, 5));
+    baseline.apply(Swap(4, 5));
+    EXPECT_EQ(3, routed.getStats().decompositions);
+    EXPECT_EQ(4, baseline.getStats().decompositions);
+}
+
+TEST(QASM_PROGRAM_TEST, RUN_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_chain(6, false);
+    const string source = R"(
+OPENQASM 2.0;
+include "qelib1.inc";
+qreg q[4];
+creg c[4];
+U(theta, 0, 0) q[0];
+cx q[0], q[3]; // routed by the circuit on the chain
+swap q[1], q[2]; // relabeled
+measure q -> c;
+)";
+    auto program = QasmProgram::parse(source, topology);
+    ASSERT_EQ(vector<string>{"theta"}, program.getParameters());
+
+    for(double theta : {0.0, M_PI}) {
+        QCircuit circuit(topology);
+        circuit.setCutoff(1e-5);
+        auto bits = program.run(circuit, {{"theta", theta}});
+        const uint64_t expected = (theta == 0.0) ? 0 : 9; // q[0] and q[3]
+        EXPECT_EQ(expected, program.registerValue(bits, "c"));
+        EXPECT_EQ(1, circuit.siteOf(3)); // moved next to q[0] through the sites 2 and 1
+        EXPECT_EQ(3, circuit.siteOf(1)); // moved to the site 2 by the routing, then relabeled with q[2]
+        EXPECT_EQ(2, circuit.siteOf(2));
+    }
+
+    EXPECT_THROW(QasmProgram::parse("OPENQASM 2.0; qreg q[2]; ccx q[0], q[1];", topology), QCircuitException);
+    QCircuit circuit(topology);
+    EXPECT_THROW(program.run(circuit), QCircuitException); // unbound parameter
+}
+
+TEST(QASM_PROGRAM_TEST, PARAMETER_SWEEP_TEST) {
+    using namespace std;
+    using namespace qcircuit;
+
+    const auto topology = make_chain(4, false);
+    QCircuit prefix(topology);
+    prefix.setCutoff(1e-5);
+    prefix.apply(H(0)); // common to all the points
+
+    auto program = QasmProgram::parse(R"(
+OPENQASM 2.0;
+include "qelib1.inc";
+qreg q[4];
+cx q[0], q[1];
+U(theta, 0, 0) q[3];
+)", topology);
+    auto sweep = ParameterSweep::fromProgram(prefix, program, {"theta"}, {{0.0}, {M_PI}, {M_PI/2}});
+    sweep.setShots(8).setSeed(1).setNumThreads(2);
+
+    auto results = sweep.run();
+    ASSERT_EQ(3, results.size());
+    for(auto&& result : results) {
+        EXPECT_NEAR(0.0, result.expectations[0], 1e-3);
+        EXPECT_NEAR(0.0, result.expectations[1], 1e-3);
+        EXPECT_NEAR(1.0, result.expectations[2], 1e-3);
+        ASSERT_EQ(8*4, result.samples.size());
+        for(size_t shot = 0;shot < 8;shot++) {
+            EXPECT_EQ(result.samples[shot*4 + 0], result.samples[shot*4 + 1]);
+        }
+    }
+    EXPECT_NEAR(1.0, results[0].expectations[3], 1e-3);
+    EXPECT_NEAR(-1.0, results[1].expectations[3], 1e-3);
+    EXPECT_NEAR(0.0, results[2].expectations[3], 1e-3);
+
+    // Points are reproducible wherever they are evaluated, and results survive serialization.
+    auto again = sweep.evaluate(2);
+    EXPECT_EQ(results[2].samples, again.samples);
+    stringstream ss;
+    again.write(ss);
+    auto restored = SweepResult::read(ss);
+    EXPECT_EQ(again.point, restored.point);
+    EXPECT_EQ(again.expectations, restored.expectations);
+    EXPECT_EQ(again.samples, restored.samples);
+
+    // A sweep restored from the checkpoint of the prefix gives the same results.
+    auto copied = sweep;
+    copied.setCheckpoint(sweep.getCheckpoint());
+    EXPECT_EQ(results[1].samples, copied.evaluate(1).samples);
+
+    auto failing = ParameterSweep(prefix, [](QCircuit&, const vector<double>&) -> vector<int> {
+        throw QCircuitException("failed");
+    }, {{0.0}});
+    EXPECT_THROW(failing.run(), QCircuitException);
+    EXPECT_EQ("failed", failing.evaluateNoThrow(0).error);
+}